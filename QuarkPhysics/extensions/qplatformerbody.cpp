@@ -210,8 +210,8 @@ QPlatformerBody::CollisionTestInfo QPlatformerBody::GetPlatformCollisions(QVecto
 				continue;
 			}
 		}
-		for(size_t j=0;j<manifold.contacts.size();++j ){
-			QCollision::Contact* contact=manifold.contacts[j];
+		for(size_t j=0;j<manifold.GetContactCount();++j ){
+			QCollision::Contact* contact=manifold.GetContactAt(j);
 			if( FilterByMovingDirection==true  ){
 				QVector collisionNormal=contact->normal;
 				if(contact->particle->GetOwnerMesh()->GetOwnerBody()!=this ){
@@ -500,8 +500,8 @@ void QPlatformerBody::PostUpdate()
 			}
 		}
 
-		for(size_t j=0;j<manifold.contacts.size();++j){
-			QCollision::Contact * contact=manifold.contacts[j];
+		for(size_t j=0;j<manifold.GetContactCount();++j){
+			QCollision::Contact * contact=manifold.GetContactAt(j);
 			QVector normal=contact->particle->GetOwnerMesh()->GetOwnerBody()==this ? contact->normal:-contact->normal;
 			
 			float floorAngle=QVector::AngleBetweenTwoVectors(normal,upDirection);
@@ -541,8 +541,8 @@ void QPlatformerBody::PostUpdate()
 				continue;
 			}
 		}
-		for(size_t j=0;j<manifold.contacts.size();++j){
-			QCollision::Contact * contact=manifold.contacts[j];
+		for(size_t j=0;j<manifold.GetContactCount();++j){
+			QCollision::Contact * contact=manifold.GetContactAt(j);
 			QVector normal=contact->particle->GetOwnerMesh()->GetOwnerBody()==this ? contact->normal:-contact->normal;
 			
 			float floorAngle=QVector::AngleBetweenTwoVectors(normal,upDirection);
@@ -83,30 +83,10 @@ void QAngleConstraint::Update(float specifiedRigidity,bool addToAccumulatedForce
 	QVector toPrev=pA->GetGlobalPosition()-pB->GetGlobalPosition();
 	QVector toNext=pC->GetGlobalPosition()-pB->GetGlobalPosition();
 
-	float cosA=toNext.Dot(toPrev)/(toPrev.Length()*toNext.Length() );
-	float sinA=toNext.Dot(toPrev.Perpendicular() )/(toPrev.Length()*toNext.Length() );
-
-	float angleRad=atan2(sinA,cosA);
-
-	if(angleRad<0){
-		angleRad=(M_PI*2.0)-abs(angleRad);
-	}
-
-	if(beginToSaveAngles){
-		prevAngle=angleRad;
-		currentAngle=angleRad;
-		beginToSaveAngles=false;
+	if(UpdateCurrentAngle(toPrev,toNext)==false){
 		return;
 	}
-	QVector d1=QVector::AngleToUnitVector(prevAngle);
-	QVector d2=QVector::AngleToUnitVector(angleRad);
-	float angleDifference=QVector::AngleBetweenTwoVectors(d2,d1);
-
-	
-
-	angleRad=prevAngle+angleDifference;
-
-	currentAngle=angleRad;
+	float angleRad=currentAngle;
 
 	if(angleRad>maxAngle){
 		float diffAngle=maxAngle-angleRad;
@@ -161,7 +141,100 @@ void QAngleConstraint::Update(float specifiedRigidity,bool addToAccumulatedForce
 
 		
 	}
-	prevAngle=angleRad;
 
 
 }
+
+void QAngleConstraint::UpdateWithCompliance(float compliance, float timeStep)
+{
+	if(enabled==false)
+		return;
+	if(timeStep==0.0f)
+		return;
+
+	QVector toPrev=pA->GetGlobalPosition()-pB->GetGlobalPosition();
+	QVector toNext=pC->GetGlobalPosition()-pB->GetGlobalPosition();
+
+	if(UpdateCurrentAngle(toPrev,toNext)==false){
+		return;
+	}
+
+	//The angle range is an inequality constraint, the nearest limit is solved. The accumulated multiplier is clamped to the sign of the limit (>=0 for the minimum, <=0 for the maximum), so the constraint can only push the angle into the range.
+	bool isMaximumLimit=currentAngle-maxAngle>minAngle-currentAngle;
+	float c=isMaximumLimit ? currentAngle-maxAngle : currentAngle-minAngle;
+	//The multiplier of the other limit is released
+	if( (isMaximumLimit && lambda>0.0f) || (isMaximumLimit==false && lambda<0.0f) ){
+		lambda=0.0f;
+	}
+	bool isInRange=isMaximumLimit ? c<=0.0f : c>=0.0f;
+	if(isInRange && lambda==0.0f){
+		return;
+	}
+
+	float toPrevLengthSq=toPrev.LengthSquared();
+	float toNextLengthSq=toNext.LengthSquared();
+	if(toPrevLengthSq==0.0f || toNextLengthSq==0.0f)
+		return;
+
+	//Gradients of the angle with respect to the particle positions
+	QVector gradA=-toPrev.Perpendicular()/toPrevLengthSq;
+	QVector gradC=toNext.Perpendicular()/toNextLengthSq;
+	QVector gradB=-(gradA+gradC);
+
+	float wA=pA->GetEnabled() && pA->GetMass()>0.0f ? 1.0f/pA->GetMass() : 0.0f;
+	float wB=pB->GetEnabled() && pB->GetMass()>0.0f ? 1.0f/pB->GetMass() : 0.0f;
+	float wC=pC->GetEnabled() && pC->GetMass()>0.0f ? 1.0f/pC->GetMass() : 0.0f;
+
+	float alpha=compliance/(timeStep*timeStep);
+	float denominator=wA*gradA.LengthSquared()+wB*gradB.LengthSquared()+wC*gradC.LengthSquared()+alpha;
+	if(denominator==0.0f)
+		return;
+
+	float deltaLambda=(-c-alpha*lambda)/denominator;
+	float clampedLambda=isMaximumLimit ? min(lambda+deltaLambda,0.0f) : max(lambda+deltaLambda,0.0f);
+	deltaLambda=clampedLambda-lambda;
+	lambda=clampedLambda;
+	if(deltaLambda==0.0f)
+		return;
+
+	if(wA>0.0f){
+		pA->ApplyForce(gradA*(wA*deltaLambda) );
+	}
+	if(wB>0.0f){
+		pB->ApplyForce(gradB*(wB*deltaLambda) );
+	}
+	if(wC>0.0f){
+		pC->ApplyForce(gradC*(wC*deltaLambda) );
+	}
+
+}
+
+bool QAngleConstraint::UpdateCurrentAngle(QVector toPrev, QVector toNext)
+{
+	float cosA=toNext.Dot(toPrev)/(toPrev.Length()*toNext.Length() );
+	float sinA=toNext.Dot(toPrev.Perpendicular() )/(toPrev.Length()*toNext.Length() );
+
+	float angleRad=atan2(sinA,cosA);
+
+	if(angleRad<0){
+		angleRad=(M_PI*2.0)-abs(angleRad);
+	}
+
+	if(beginToSaveAngles){
+		prevAngle=angleRad;
+		currentAngle=angleRad;
+		beginToSaveAngles=false;
+		return false;
+	}
+	QVector d1=QVector::AngleToUnitVector(prevAngle);
+	QVector d2=QVector::AngleToUnitVector(angleRad);
+	float angleDifference=QVector::AngleBetweenTwoVectors(d2,d1);
+
+	
+
+	angleRad=prevAngle+angleDifference;
+
+	currentAngle=angleRad;
+	prevAngle=angleRad;
+	return true;
+}
@@ -46,7 +46,12 @@ class QAngleConstraint
 	float prevAngle=0.0f;
 	bool enabled=true;
 	bool beginToSaveAngles=true;
-	
+	float compliance=0.0f;
+	float lambda=0.0f;
+
+	bool UpdateCurrentAngle(QVector toPrev,QVector toNext);
+
+	friend class QMesh;
 
 public:
 	/**
@@ -75,6 +80,18 @@ public:
 	 */
 	virtual void Update(float specifiedRigidity=-1.0f,bool addToAccumulatedForces=false);
 
+	/**
+	 * Applies angle constraints with the XPBD (extended position based dynamics) method and updates particle positions. Unlike the rigidity, the compliance is independent of the iteration count and the time step. The accumulated Lagrange multiplier of the constraint must be reset with ResetLagrangeMultiplier() at the beginning of each step.
+	 * @param compliance The compliance of the constraint. It's the inverse of the stiffness, 0.0 means an infinitely stiff constraint.
+	 * @param timeStep The time step of the simulation step.
+	 */
+	virtual void UpdateWithCompliance(float compliance,float timeStep);
+
+	/** Resets the accumulated Lagrange multiplier of the constraint. The XPBD solver calls it at the beginning of each step. */
+	void ResetLagrangeMultiplier(){
+		lambda=0.0f;
+	}
+
 	//Get Methods
 	/** Returns particleA of the angle constraint */
 	QParticle *GetParticleA(){
@@ -100,6 +117,10 @@ public:
 	float GetRigidity(){
 		return rigidity;
 	}
+	/** Returns the compliance of the angle constraint. It's used instead of the rigidity when the world uses the XPBD constraint solver. */
+	float GetCompliance(){
+		return compliance;
+	}
 	/** Returns whether the angle constraint is enabled. */
 	bool GetEnabled(){
 		return enabled;
@@ -161,6 +182,14 @@ public:
 		this->rigidity=rigidity;
 		return this;
 	}
+	/** Sets the compliance of the constraint. It's used instead of the rigidity when the world uses the XPBD constraint solver.
+	 * @param value The compliance value to set. It's the inverse of the stiffness, 0.0 means an infinitely stiff constraint.
+	 * @return A pointer to the spring itself.
+	 */
+	QAngleConstraint *SetCompliance(float value){
+		compliance=value;
+		return this;
+	}
 	/** Sets whether the angle constraint is enabled. 
 	 * @param value True or false.
 	 * @return A pointer to the spring itself.
@@ -108,8 +108,8 @@ void QAreaBody::CheckBodies(){
 									break;
 								}
 								
-								for(auto rp:contact->referenceParticles){
-									if(rp==particle){
+								for(int n=0;n<contact->referenceParticleCount;++n){
+									if(contact->referenceParticles[n]==particle){
 										particleIsColliding=true;
 										break;
 									}
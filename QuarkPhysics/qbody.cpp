@@ -199,8 +199,29 @@ void QBody::UpdateAABB(){
 	float maxX=-QWorld::MAX_WORLD_SIZE;
 	float maxY=-QWorld::MAX_WORLD_SIZE;
 
+	//The particles of the rigid bodies are transformed from their local positions, so the AABB is calculated from the local bounds of the meshes
+	bool useLocalBounds=simulationModel==SimulationModels::RIGID_BODY && bodyType!=BodyTypes::SOFT;
+
 	for(int i=0;i<_meshes.size();i++){
 	   QMesh* shape=_meshes[i];
+	   if(useLocalBounds){
+		   if(shape->particles.empty())
+			   continue;
+		   if(shape->localBoundsNeedsUpdate)
+			   shape->UpdateLocalBounds();
+		   //The AABB of the rotated local bounds. The bounding circle has the same center, its AABB is tighter for some rotations and both of them contain the particles.
+		   QVector rotVecUnit=shape->globalRotationUnit;
+		   QVector localCenter=shape->localBoundingCenter;
+		   QVector localExtents=(shape->localBoundsMax-shape->localBoundsMin)*0.5f;
+		   QVector center=shape->globalPosition+QVector(localCenter.x*rotVecUnit.x-localCenter.y*rotVecUnit.y, localCenter.y*rotVecUnit.x+localCenter.x*rotVecUnit.y);
+		   float extentX=min(abs(rotVecUnit.x)*localExtents.x+abs(rotVecUnit.y)*localExtents.y,shape->localBoundingRadius);
+		   float extentY=min(abs(rotVecUnit.y)*localExtents.x+abs(rotVecUnit.x)*localExtents.y,shape->localBoundingRadius);
+		   minX=min(minX,center.x-extentX);
+		   minY=min(minY,center.y-extentY);
+		   maxX=max(maxX,center.x+extentX);
+		   maxY=max(maxY,center.y+extentY);
+		   continue;
+	   }
 	   for(int n=0;n<shape->particles.size();n++){
 		   QParticle *particle=shape->particles[n];
 		   float  r=particle->GetRadius()>0.5f ? particle->GetRadius():0;
@@ -226,25 +247,40 @@ void QBody::UpdateAABB(){
 
 void QBody::UpdateMeshTransforms(){
 	//Transforming mesh particle positions according to self rotation
+	//The body rotation unit is computed once and shared by the meshes without local rotations.
+	QVector bodyRotationUnit=QVector::AngleToUnitVector(rotation);
+	bool isRigid=bodyType==QBody::BodyTypes::RIGID;
 	
 	for(int n=0;n<_meshes.size();n++){
 		QMesh* mesh=_meshes[n];
 		mesh->globalRotation=rotation+mesh->rotation;
-		QVector rotVecUnit=QVector::AngleToUnitVector(mesh->globalRotation);
-		mesh->globalPosition=position+mesh->position.Rotated(rotation);
-		for(int i=0;i<mesh->GetParticleCount();i++){
-			QParticle * particle=mesh->GetParticleAt(i);
-			QVector originVec=particle->GetPosition();
+		QVector rotVecUnit=mesh->rotation==0.0f ? bodyRotationUnit : QVector::AngleToUnitVector(mesh->globalRotation);
+		mesh->globalRotationUnit=rotVecUnit;
+		if(rotation==0.0f){
+			mesh->globalPosition=position+mesh->position;
+		}else{
+			float mx=mesh->position.x*bodyRotationUnit.x-mesh->position.y*bodyRotationUnit.y;
+			float my=mesh->position.x*bodyRotationUnit.y+mesh->position.y*bodyRotationUnit.x;
+			mesh->globalPosition=position+QVector(mx,my);
+		}
+		QVector meshGlobalPosition=mesh->globalPosition;
+		for(size_t i=0;i<mesh->particles.size();i++){
+			QParticle * particle=mesh->particles[i];
+			QVector originVec=particle->position;
 			float nx=originVec.x*rotVecUnit.x-originVec.y*rotVecUnit.y;
 			float ny=originVec.y*rotVecUnit.x+originVec.x*rotVecUnit.y;
-			QVector newPos=mesh->globalPosition+QVector(nx,ny);
-			if (bodyType==QBody::BodyTypes::RIGID){
-				particle->SetPreviousGlobalPosition(particle->GetGlobalPosition());
-			}else{
-				particle->SetPreviousGlobalPosition(newPos);
+			QVector newPos=meshGlobalPosition+QVector(nx,ny);
+			particle->prevGlobalPosition=isRigid ? particle->globalPosition : newPos;
+			particle->globalPosition=newPos;
+			particle->aabbNeedsUpdate=true;
+		}
+		//The invalidations of QParticle::SetGlobalPosition() are applied once per mesh
+		if(mesh->particles.size()>0){
+			mesh->subConvexPolygonCachesNeedsUpdate=true;
+			mesh->polygonSegmentBVHNeedsUpdate=true;
+			if(bodyType==QBody::BodyTypes::SOFT){
+				mesh->polygonBisectorsNeedsUpdate=true;
 			}
-			particle->SetGlobalPosition(newPos);
-			
 		}
 	}
 
@@ -253,6 +289,10 @@ void QBody::UpdateMeshTransforms(){
 void QBody::Update()
 {
 	for (auto mesh: _meshes){
+		//The finished asynchronous decompositions are applied at the beginning of the step.
+		if(mesh->pendingDecomposition.valid() ){
+			mesh->ApplyPendingDecomposition(false);
+		}
 		for(size_t i=0;i<mesh->GetParticleCount();++i ){
 			QParticle *particle=mesh->GetParticleAt(i);
 			if (particle->GetIsLazy()==true ){
@@ -125,6 +125,18 @@ protected:
 	int fixedAngularTick=0;
 	bool canSleep=true;
 
+	//Adaptive Iterations Features
+	int minimumIterationCount=1;
+	int maximumIterationCount=0;
+	//Whether the island of the body is converged in the current step, its constraints and collisions aren't solved in the next iterations.
+	bool iterationsConverged=false;
+	//Whether the converged body is pushed by the manifolds of the other bodies in the current iteration, its AABB is refreshed in the next iteration.
+	bool iterationMoved=false;
+	int iterationIslandIndex=-1;
+	//The maximum penetration and spring error of the body in the previous iteration, they're negative in the first iteration.
+	float iterationPenetration=-1.0f;
+	float iterationConstraintError=-1.0f;
+
 	
 
 	
@@ -299,6 +311,14 @@ protected:
 		bool GetCanSleep(){
 			return canSleep;
 		}
+		/** Returns the minimum iteration count of the body when the adaptive iterations of the world are enabled. */
+		int GetMinimumIterationCount(){
+			return minimumIterationCount;
+		}
+		/** Returns the maximum iteration count of the body when the adaptive iterations of the world are enabled. If it's 0, the iteration count of the world is used. */
+		int GetMaximumIterationCount(){
+			return maximumIterationCount;
+		}
 		/** Returns which approach will be used to simulate a body object. */
 		SimulationModels GetSimulationModel(){
 			return simulationModel;
@@ -497,6 +517,22 @@ protected:
 			canSleep=value;
 			return this;
 		}
+		/** Sets the minimum iteration count of the body when the adaptive iterations of the world are enabled. The island of the body is solved at least with this iteration count, even if it's converged before. The default value is 1.
+		 * @param value The iteration count to set. 
+		 * @return A pointer to the body itself.
+		 */
+		QBody *SetMinimumIterationCount(int value){
+			minimumIterationCount=value;
+			return this;
+		}
+		/** Sets the maximum iteration count of the body when the adaptive iterations of the world are enabled. The island of the body is solved at most with the largest maximum iteration count of its bodies. It can be higher than the iteration count of the world for the bodies that need more stability, like tall stacks. The default value is 0, it means the iteration count of the world is used.
+		 * @param value The iteration count to set. 
+		 * @return A pointer to the body itself.
+		 */
+		QBody *SetMaximumIterationCount(int value){
+			maximumIterationCount=value;
+			return this;
+		}
 		/** Sets whether the body is dynamic or static. 
 		 * @param bodyMode A mode to set. 
 		 * @return A pointer to the body itself.
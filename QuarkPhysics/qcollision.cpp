@@ -109,12 +109,36 @@ void QCollision::PolylineAndPolygon(vector<QParticle*> &polylineParticles, vecto
 		
 
 		bisectorList.push_back(bisectorVector );
-		//p->GetOwnerMesh()->GetOwnerBody()->GetWorld()->gizmos.push_back(new QGizmoLine(p->GetGlobalPosition(),p->GetGlobalPosition()+bisectorVector,true) );
+		//p->GetOwnerMesh()->GetOwnerBody()->GetWorld()->GetGizmos()->AddLine(p->GetGlobalPosition(),p->GetGlobalPosition()+bisectorVector,true);
 
 		
 
 
 
+	}
+
+	//Long polylines find the candidate segments of each polygon particle with the segment BVH of their mesh. The pairs are sorted to keep the order of the brute force loops.
+	QMesh *polylineMesh=GetSegmentBVHMesh(polylineParticles);
+	static thread_local vector<pair<int,int> > candidatePairs;
+	static thread_local vector<int> candidateSegments;
+	size_t pairIndex=0;
+	if(polylineMesh!=nullptr){
+		candidatePairs.clear();
+		for(int n=0;n<polygonParticles.size();n++){
+			if (bisectorList[n]==QVector::Zero() )
+				continue;
+			QParticle *p=polygonParticles[n];
+			QVector pPos=p->GetGlobalPosition();
+			QVector rayEnd=pPos+bisectorList[n];
+			QVector radiusVec(p->GetRadius(),p->GetRadius() );
+			QAABB rayAABB(QVector(min(pPos.x,rayEnd.x),min(pPos.y,rayEnd.y))-radiusVec,QVector(max(pPos.x,rayEnd.x),max(pPos.y,rayEnd.y))+radiusVec );
+			candidateSegments.clear();
+			polylineMesh->GetPolygonSegmentsInAABB(rayAABB,candidateSegments);
+			for(auto segmentIndex:candidateSegments){
+				candidatePairs.push_back(make_pair(segmentIndex,n) );
+			}
+		}
+		sort(candidatePairs.begin(),candidatePairs.end() );
 	}
 
 	//A. Start the loop for all segments of the polyline
@@ -122,6 +146,18 @@ void QCollision::PolylineAndPolygon(vector<QParticle*> &polylineParticles, vecto
 
 	for(int i=0;i<polylineParticles.size();i++){
 
+		int candidateBegin=0;
+		int candidateEnd=polygonParticles.size();
+		if(polylineMesh!=nullptr){
+			if(pairIndex==candidatePairs.size() )
+				break;
+			if(candidatePairs[pairIndex].first!=i)
+				continue;
+			candidateBegin=pairIndex;
+			while(pairIndex<candidatePairs.size() && candidatePairs[pairIndex].first==i)
+				pairIndex++;
+			candidateEnd=pairIndex;
+		}
 		
 		QParticle *s1=polylineParticles[i];
 		QParticle *s2=polylineParticles[ (i+1)%polylineParticles.size() ];
@@ -151,7 +187,8 @@ void QCollision::PolylineAndPolygon(vector<QParticle*> &polylineParticles, vecto
 
 		//B. Start the loop for all particles of the polygon
 
-		for(int n=0;n<polygonParticles.size();n++){
+		for(int c=candidateBegin;c<candidateEnd;c++){
+			int n=polylineMesh!=nullptr ? candidatePairs[c].second : c;
 			if (bisectorList[n]==QVector::Zero() )
 				continue;
 			QParticle *p=polygonParticles[n];
@@ -181,7 +218,7 @@ void QCollision::PolylineAndPolygon(vector<QParticle*> &polylineParticles, vecto
 			if( intersection.isNaN() )continue;
 
 
-			//p->GetOwnerMesh()->GetOwnerBody()->GetWorld()->gizmos.push_back( new QGizmoLine(pPos,pPos+bisectorList[n],true) );
+			//p->GetOwnerMesh()->GetOwnerBody()->GetWorld()->GetGizmos()->AddLine(pPos,pPos+bisectorList[n],true);
 
 
 			//D. If the intersection is exist, calculate the distance between the particle of polygon and the segment of polyline
@@ -192,7 +229,7 @@ void QCollision::PolylineAndPolygon(vector<QParticle*> &polylineParticles, vecto
 			
 			
 			QCollision::Contact *contact=QCollision::GetContactPool().Create().data;
-			contact->Configure(p,p->GetGlobalPosition(),normal,penetration,vector<QParticle*>{s1,s2});
+			contact->Configure(p,p->GetGlobalPosition(),normal,penetration,s1,s2);
 			contacts.push_back(contact);
 
 		}
@@ -218,6 +255,10 @@ void QCollision::PolylineAndPolyline(vector<QParticle*> &testPolylineParticles,v
 	
 
 	vector< vector<QParticle*> > nearestSides;
+
+	//Long target polylines cull the particle and segment tests with the segment BVH of their mesh.
+	QMesh *targetMesh=GetSegmentBVHMesh(targetPolylineParticles);
+	static thread_local vector<int> candidateSegments;
 	
 	
 	
@@ -240,14 +281,39 @@ void QCollision::PolylineAndPolyline(vector<QParticle*> &testPolylineParticles,v
 		//Checking whether the cirlce particle is in the polyline. 
 		bool circleCenterInsidePolyline=false;
 		if (testPolylineParticles!=targetPolylineParticles){
-			if (PointInPolygonWN(pA->GetGlobalPosition(),targetPolylineParticles)){
+			bool isPointInPolygon=false;
+			if(targetMesh!=nullptr){
+				//Only the segments crossing the horizontal ray of the winding number test can change the winding number.
+				QVector point=pA->GetGlobalPosition();
+				candidateSegments.clear();
+				targetMesh->GetPolygonSegmentsInAABB(QAABB(point,QVector(QWorld::MAX_WORLD_SIZE,point.y) ),candidateSegments);
+				int windingNumber=0;
+				for(auto j:candidateSegments){
+					windingNumber+=GetWindingNumberOfSide(point,targetPolylineParticles[j]->GetGlobalPosition(),targetPolylineParticles[(j+1)%targetPolylineParticles.size()]->GetGlobalPosition() );
+				}
+				isPointInPolygon=windingNumber!=0;
+			}else{
+				isPointInPolygon=PointInPolygonWN(pA->GetGlobalPosition(),targetPolylineParticles);
+			}
+			if (isPointInPolygon){
 				circleCenterInsidePolyline=true;
 			}else{
 				//intersection tests between target particle sides and polyline
 				if(testPolylineParticles.size()>3 && targetPolylineParticles.size()>3 ){
 					QParticle *ppA=testPolylineParticles[ (ia-1+testPolylineParticles.size() )%testPolylineParticles.size() ];
 					QParticle *npA=testPolylineParticles[ (ia+1 )%testPolylineParticles.size() ];
-					for(size_t j=0;j<targetPolylineParticles.size();++j ){
+					size_t candidateCount=targetPolylineParticles.size();
+					if(targetMesh!=nullptr){
+						QVector posA=pA->GetGlobalPosition();
+						QVector prevPosA=ppA->GetGlobalPosition();
+						QVector nextPosA=npA->GetGlobalPosition();
+						QAABB sidesAABB(QVector(min(min(posA.x,prevPosA.x),nextPosA.x),min(min(posA.y,prevPosA.y),nextPosA.y)),QVector(max(max(posA.x,prevPosA.x),nextPosA.x),max(max(posA.y,prevPosA.y),nextPosA.y)) );
+						candidateSegments.clear();
+						targetMesh->GetPolygonSegmentsInAABB(sidesAABB,candidateSegments);
+						candidateCount=candidateSegments.size();
+					}
+					for(size_t c=0;c<candidateCount;++c ){
+						size_t j=targetMesh!=nullptr ? candidateSegments[c] : c;
 						QParticle * pJ=targetPolylineParticles[j];
 						QParticle *npJ=targetPolylineParticles[ (j+1)% targetPolylineParticles.size() ];
 						bool sideIntersectionA=LineIntersectionLine(ppA->GetGlobalPosition(),pA->GetGlobalPosition(),pJ->GetGlobalPosition(), npJ->GetGlobalPosition() ).isNaN()==false;
@@ -304,7 +370,7 @@ void QCollision::PolylineAndPolyline(vector<QParticle*> &testPolylineParticles,v
 
 			
 
-			int ni=FindNearestParticleOfPolygon(pA,targetPolylineParticles );
+			int ni=targetMesh!=nullptr ? targetMesh->FindNearestPolygonParticle(pA->GetGlobalPosition(),pA) : FindNearestParticleOfPolygon(pA,targetPolylineParticles );
 
 			QParticle *pB=targetPolylineParticles[ni];
 
@@ -391,14 +457,14 @@ void QCollision::PolylineAndPolyline(vector<QParticle*> &testPolylineParticles,v
 						QVector bridgeVec=pA->GetGlobalPosition()-sAPos;
 						float dist=bridgeVec.Dot( sideNormal );
 						float distIntersection=(intersection-pA->GetGlobalPosition()).Length();
-						//pA->GetOwnerMesh()->GetOwnerBody()->GetWorld()->gizmos.push_back(new QGizmoLine(pA->GetGlobalPosition(),pA->GetGlobalPosition()+rayUnit*16,true ) );
+						//pA->GetOwnerMesh()->GetOwnerBody()->GetWorld()->GetGizmos()->AddLine(pA->GetGlobalPosition(),pA->GetGlobalPosition()+rayUnit*16,true);
 						if(dist<0 && dist>minDistance){
 							minDistance=dist;
 							normal=sideNormal;
 							penetration=dist-radius;
 							collidedSideIndex=n;
-							//pA->GetOwnerMesh()->GetOwnerBody()->GetWorld()->gizmos.push_back(new QGizmoLine(pA->GetGlobalPosition(),pA->GetGlobalPosition()+rayUnit*16,true ) );
-							//pA->GetOwnerMesh()->GetOwnerBody()->GetWorld()->gizmos.push_back(new QGizmoLine(sAPos,sBPos,false ) );
+							//pA->GetOwnerMesh()->GetOwnerBody()->GetWorld()->GetGizmos()->AddLine(pA->GetGlobalPosition(),pA->GetGlobalPosition()+rayUnit*16,true);
+							//pA->GetOwnerMesh()->GetOwnerBody()->GetWorld()->GetGizmos()->AddLine(sAPos,sBPos,false);
 						}
 					}
 				}else{
@@ -458,11 +524,11 @@ void QCollision::PolylineAndPolyline(vector<QParticle*> &testPolylineParticles,v
 			}
 		
 
-			//pA->GetOwnerMesh()->GetOwnerBody()->GetWorld()->gizmos.push_back(new QGizmoCircle(pA->GetGlobalPosition(),5.0f ) );
+			//pA->GetOwnerMesh()->GetOwnerBody()->GetWorld()->GetGizmos()->AddCircle(pA->GetGlobalPosition(),5.0f);
 
 			
 			QCollision::Contact *contact=QCollision::GetContactPool().Create().data;
-			contact->Configure( pA,pA->GetGlobalPosition(),normal,-penetration,vector<QParticle*>{ nearestSides[collidedSideIndex][0],nearestSides[collidedSideIndex][1] }  );
+			contact->Configure( pA,pA->GetGlobalPosition(),normal,-penetration,nearestSides[collidedSideIndex][0],nearestSides[collidedSideIndex][1]  );
 			contacts.push_back(contact) ;
 
 			//For the Hot Response
@@ -570,7 +636,7 @@ void QCollision::PolylineAndPolyline(vector<QParticle*> &testPolylineParticles,v
 					QParticle *s1=nearestSides[nearestSideIndex][0];
 					QParticle *s2=nearestSides[nearestSideIndex][1];
 					QCollision::Contact *contact=QCollision::GetContactPool().Create().data;
-					contact->Configure(pA,contactPosition,contactNormal,contactPenetration,vector<QParticle*>{s1,s2});
+					contact->Configure(pA,contactPosition,contactNormal,contactPenetration,s1,s2);
 					contacts.push_back(contact);
 
 					//For the Hot Response
@@ -665,7 +731,7 @@ void QCollision::CircleAndPolyline2(vector<QParticle *> &particles, vector<QPart
 				}
 
 				QCollision::Contact *contact=QCollision::GetContactPool().Create().data;
-				contact->Configure( particle,particle->GetGlobalPosition(),normal,abs(penetration),vector<QParticle*>{ sideParticleA,sideParticleB }  );
+				contact->Configure( particle,particle->GetGlobalPosition(),normal,abs(penetration),sideParticleA,sideParticleB  );
 				contacts.push_back(contact) ;
 				
 			}
@@ -689,15 +755,34 @@ void QCollision::CircleAndCircle(vector<QParticle *> &particlesA, vector<QPartic
 	D. If the distance is less than radius of these points, apply the collision
 	*/
 
+	//Closed form test of two single circles (e.g. rigid circle bodies). It doesn't need the sweep and prune structures.
+	if(particlesA.size()==1 && particlesB.size()==1 && specifiedRadius==0.0f){
+		QParticle *pA=particlesA[0];
+		QParticle *pB=particlesB[0];
+		float totalRadius=pA->GetRadius()+pB->GetRadius();
+		QVector distVec=pB->GetGlobalPosition()-pA->GetGlobalPosition();
+		float distSq=distVec.LengthSquared();
+		if(distSq<totalRadius*totalRadius){
+			QVector normal;
+			if(velocitySensitive){
+				normal=(pB->GetPreviousGlobalPosition()-pA->GetPreviousGlobalPosition()).Normalized();
+			}else{
+				normal=distVec.Normalized();
+			}
+			float penetration=totalRadius-sqrt(distSq);
+			QCollision::Contact *contact=QCollision::GetContactPool().Create().data;
+			contact->Configure(pB,pA->GetGlobalPosition()+pA->GetRadius()*normal,normal,penetration,pA);
+			contacts.push_back(contact);
+		}
+		return;
+	}
 
-	//Speep & Prune Implement
-	vector<QParticle*> orderedParticlesA(particlesA.size() );
-	copy(particlesA.begin(),particlesA.end(),orderedParticlesA.begin() );
-	sort(orderedParticlesA.begin(),orderedParticlesA.end(),QParticle::SortParticlesHorizontal);
 
-	vector<QParticle*> orderedParticlesB(particlesB.size() );
-	copy(particlesB.begin(),particlesB.end(),orderedParticlesB.begin() );
-	sort(orderedParticlesB.begin(),orderedParticlesB.end(),QParticle::SortParticlesHorizontal);
+	//Speep & Prune Implement
+	static thread_local vector<QParticle*> sortedCopyA;
+	static thread_local vector<QParticle*> sortedCopyB;
+	vector<QParticle*> &orderedParticlesA=GetParticlesSortedHorizontally(particlesA,sortedCopyA);
+	vector<QParticle*> &orderedParticlesB=GetParticlesSortedHorizontally(particlesB,sortedCopyB);
 
 
 
@@ -788,7 +873,7 @@ void QCollision::CircleAndCircle(vector<QParticle *> &particlesA, vector<QPartic
 
 							//auto contact=QCollision::GetContactPool();
 							QCollision::Contact *contact=QCollision::GetContactPool().Create().data;
-							contact->Configure(pB,contactPosition,normal,penetration,vector<QParticle*>{pA});
+							contact->Configure(pB,contactPosition,normal,penetration,pA);
 							contacts.push_back(contact);
 							
 
@@ -805,6 +890,113 @@ void QCollision::CircleAndCircle(vector<QParticle *> &particlesA, vector<QPartic
 
 }
 
+void QCollision::CircleAndCircle(vector<QParticle *> &particlesA, QMesh *meshB, QParticleGrid &grid, QAABB boundingBoxB, vector<QCollision::Contact *> &contacts, float specifiedRadius, bool velocitySensitive)
+{
+	int ranges[12];
+	QParticleGrid::Entry *entries=grid.GetSortedEntries();
+	size_t sizeA=particlesA.size();
+	if(sizeA==0)
+		return;
+	int orderBeginA=particlesA[0]->GetOwnerMesh()->particleGridOffset;
+	//The particles of a mesh are inserted to the grid consecutively, so the particles of the other mesh are found by their orders.
+	int orderBeginB=meshB->particleGridOffset;
+	int orderEndB=orderBeginB+meshB->particles.size();
+	for(size_t i=0;i<sizeA;++i){
+		QParticle *pA=particlesA[i];
+		if(pA->GetAABB().isCollidingWith(boundingBoxB)==false ){
+			continue;
+		}
+		float radiusA=specifiedRadius!=0.0f ? specifiedRadius : pA->GetRadius();
+		int rangeCount=grid.GetNeighborRanges(orderBeginA+i,ranges);
+		for(int r=0;r<rangeCount;++r){
+			QParticleGrid::Entry *end=entries+ranges[r*2+1];
+			for(QParticleGrid::Entry *entry=entries+ranges[r*2];entry!=end;++entry){
+				if(entry->order<orderBeginB || entry->order>=orderEndB)
+					continue;
+				QParticle *pB=entry->particle;
+				float radiusB=specifiedRadius!=0.0f ? specifiedRadius : pB->GetRadius();
+				CreateCircleContact(pA,pB,radiusA,radiusB,velocitySensitive,contacts);
+			}
+		}
+	}
+}
+
+void QCollision::CircleAndCircleSelf(QBody *body, QParticleGrid &grid, vector<QCollision::Contact *> &contacts, float specifiedRadius)
+{
+	int ranges[12];
+	QParticleGrid::Entry *entries=grid.GetSortedEntries();
+	//The particles of a body are inserted to the grid consecutively, so the particles of the body are found by their orders.
+	int orderEnd=0;
+	for(int m=0;m<body->GetMeshCount();++m){
+		QMesh *mesh=body->GetMeshAt(m);
+		if(mesh->particleGridOffset!=-1)
+			orderEnd=max(orderEnd,mesh->particleGridOffset+(int)mesh->particles.size() );
+	}
+	for(int m=0;m<body->GetMeshCount();++m){
+		QMesh *mesh=body->GetMeshAt(m);
+		if(mesh->particleGridOffset==-1)
+			continue;
+		size_t particleCount=mesh->particles.size();
+		for(size_t i=0;i<particleCount;++i){
+			QParticle *pA=mesh->particles[i];
+			int orderA=mesh->particleGridOffset+i;
+			float radiusA=specifiedRadius!=0.0f ? specifiedRadius : pA->GetRadius();
+			int rangeCount=grid.GetNeighborRanges(orderA,ranges);
+			for(int r=0;r<rangeCount;++r){
+				QParticleGrid::Entry *end=entries+ranges[r*2+1];
+				for(QParticleGrid::Entry *entry=entries+ranges[r*2];entry!=end;++entry){
+					//Every pair is tested only once, from the particle with the lower order.
+					if(entry->order<=orderA || entry->order>=orderEnd)
+						continue;
+					QParticle *pB=entry->particle;
+					float radiusB=specifiedRadius!=0.0f ? specifiedRadius : pB->GetRadius();
+					if(CreateCircleContact(pA,pB,radiusA,radiusB,false,contacts) ){
+						//Hot Solving
+						QManifold manifold(body,body,&contacts,contacts.size()-1,1);
+						manifold.Solve();
+						manifold.SolveFrictionAndVelocities();
+						contacts.pop_back();
+					}
+				}
+			}
+		}
+	}
+}
+
+bool QCollision::CreateCircleContact(QParticle *pA, QParticle *pB, float radiusA, float radiusB, bool velocitySensitive, vector<QCollision::Contact *> &contacts)
+{
+	float totalRadius=radiusA+radiusB;
+	QVector distVec=pB->GetGlobalPosition()-pA->GetGlobalPosition();
+	float distSq=distVec.LengthSquared();
+	if(distSq>=totalRadius*totalRadius)
+		return false;
+	QVector normal;
+	if(velocitySensitive){
+		normal=(pB->GetPreviousGlobalPosition()-pA->GetPreviousGlobalPosition()).Normalized();
+	}else{
+		normal=distVec.Normalized();
+	}
+	float penetration=totalRadius-sqrt(distSq);
+	QCollision::Contact *contact=QCollision::GetContactPool().Create().data;
+	contact->Configure(pB,pA->GetGlobalPosition()+radiusA*normal,normal,penetration,pA);
+	contacts.push_back(contact);
+	return true;
+}
+
+vector<QParticle *> &QCollision::GetParticlesSortedHorizontally(vector<QParticle *> &particles, vector<QParticle *> &sortedCopy)
+{
+	//The particle collections of meshes keep their order between the tests.
+	if(particles.size()>0){
+		QMesh *mesh=particles[0]->GetOwnerMesh();
+		if(mesh!=nullptr && &mesh->particles==&particles){
+			return mesh->GetParticlesSortedHorizontally();
+		}
+	}
+	sortedCopy.assign(particles.begin(),particles.end());
+	sort(sortedCopy.begin(),sortedCopy.end(),QParticle::SortParticlesHorizontal);
+	return sortedCopy;
+}
+
 void QCollision::CircleAndCircleSelf(vector<QParticle *> &particles, vector<QCollision::Contact *> &contacts, float specifiedRadius)
 {
 	if(particles.size()==0 )
@@ -842,9 +1034,8 @@ void QCollision::CircleAndCircleSelf(vector<QParticle *> &particles, vector<QCol
 	totalRadius=radius+radius;
 	totalRadiusPow=totalRadius*totalRadius;
 
-	vector<QParticle*> sortedParticles(particles.size());
-	copy(particles.begin(),particles.end(),sortedParticles.begin());
-	sort(sortedParticles.begin(),sortedParticles.end(),QParticle::SortParticlesHorizontal );
+	static thread_local vector<QParticle*> sortedCopy;
+	vector<QParticle*> &sortedParticles=GetParticlesSortedHorizontally(particles,sortedCopy);
 
 	for(size_t i=0;i<sortedParticles.size();++i ){
 		QParticle* pA=sortedParticles[i];
@@ -872,13 +1063,14 @@ void QCollision::CircleAndCircleSelf(vector<QParticle *> &particles, vector<QCol
 
 						//auto contact=QCollision::GetContactPool();
 						QCollision::Contact *contact=QCollision::GetContactPool().Create().data;
-						contact->Configure(pB,contactPosition,normal,penetration,vector<QParticle*>{pA});
+						contact->Configure(pB,contactPosition,normal,penetration,pA);
 						
 						//Hot Solving
-						QManifold manifold(body,body);
-						manifold.contacts={contact};
+						contacts.push_back(contact);
+						QManifold manifold(body,body,&contacts,contacts.size()-1,1);
 						manifold.Solve();
 						manifold.SolveFrictionAndVelocities();
+						contacts.pop_back();
 
 						
 						
@@ -1006,7 +1198,7 @@ void QCollision::CircleAndPolygon(vector<QParticle*> &circleParticles,vector<QPa
 				float penetration=circleParticle->GetRadius()+nearestParticlePenetration;
 				QVector contactPosition=circleParticle->GetGlobalPosition();
 				QCollision::Contact *contact=QCollision::GetContactPool().Create().data;
-				contact->Configure(circleParticle,contactPosition,-nearestParticleNormal,penetration,vector<QParticle*>{ nearestPolygonParticle } );
+				contact->Configure(circleParticle,contactPosition,-nearestParticleNormal,penetration,nearestPolygonParticle );
 				contacts.push_back(contact);
 
 			}else{
@@ -1018,7 +1210,7 @@ void QCollision::CircleAndPolygon(vector<QParticle*> &circleParticles,vector<QPa
 						contactPosition-=circleParticle->GetRadius()*nearestParticleNormal;
 					}
 					QCollision::Contact *contact=QCollision::GetContactPool().Create().data;
-					contact->Configure(circleParticle,contactPosition,nearestParticleNormal,penetration,vector<QParticle*>{ nearestPolygonParticle } );
+					contact->Configure(circleParticle,contactPosition,nearestParticleNormal,penetration,nearestPolygonParticle );
 					contacts.push_back(contact);
 
 				}
@@ -1034,12 +1226,11 @@ void QCollision::CircleAndPolygon(vector<QParticle*> &circleParticles,vector<QPa
 				if(circleParticle->GetRadius()>0.5f){
 					contactPosition-=circleParticle->GetRadius()*nearestEdgeNormal;
 				}
-				vector<QParticle*> refSegment={ nearestEdgeParticles[0],nearestEdgeParticles[1] };
 
 				
 				
 				QCollision::Contact *contact=QCollision::GetContactPool().Create().data;
-				contact->Configure(circleParticle,contactPosition,nearestEdgeNormal,penetration,refSegment );
+				contact->Configure(circleParticle,contactPosition,nearestEdgeNormal,penetration,nearestEdgeParticles[0],nearestEdgeParticles[1] );
 				contacts.push_back(contact);
 			}
 
@@ -1051,11 +1242,10 @@ void QCollision::CircleAndPolygon(vector<QParticle*> &circleParticles,vector<QPa
 			if(circleParticle->GetRadius()>0.5f){
 				contactPosition-=circleParticle->GetRadius()*nearestEdgeNormal;
 			}
-			vector<QParticle*> refSegment={ nearestEdgeParticles[0],nearestEdgeParticles[1] };
 
 			
 			QCollision::Contact *contact=QCollision::GetContactPool().Create().data;
-			contact->Configure(circleParticle,contactPosition,nearestEdgeNormal,penetration,refSegment );
+			contact->Configure(circleParticle,contactPosition,nearestEdgeNormal,penetration,nearestEdgeParticles[0],nearestEdgeParticles[1] );
 			contacts.push_back(contact);
 		}
 		
@@ -1137,7 +1327,106 @@ void QCollision::PolygonAndPolygon(vector<QParticle *> &particlesA, vector<QPart
 
 	}
 
+	FindPolygonContacts(particlesA,particlesB,refNormal,contacts);
+}
+
+void QCollision::PolygonAndPolygon(vector<QParticle *> &particlesA, ConvexPolygonCache &cacheA, vector<QParticle *> &particlesB, ConvexPolygonCache &cacheB, vector<QCollision::Contact *> &contacts, bool findTwoSidedContacts)
+{
+	//The same separating axis test with the cached edge normals and vertex positions of the polygons.
+
+	//The last separating axis of the pair is tested first. Resting bodies are usually separated by the same axis.
+	int recordIndex=cacheA.FindSeparatingAxisRecord(&cacheB);
+	if(recordIndex!=-1){
+		ConvexPolygonCache::SeparatingAxisRecord &record=cacheA.separatingAxisRecords[recordIndex];
+		ConvexPolygonCache &axisOwner=record.side==0 ? cacheA:cacheB;
+		if(record.edgeIndex<axisOwner.axisCount){
+			QVector sNormal=axisOwner.normals[record.edgeIndex];
+			float minA,maxA,minB,maxB;
+			ProjectToAxis(sNormal,cacheA,minA,maxA);
+			ProjectToAxis(sNormal,cacheB,minB,maxB);
+			if(minB>=maxA || minA>=maxB){
+				return;
+			}
+		}
+	}
+
+	float minPenetration=QWorld::MAX_WORLD_SIZE;
+	QVector refNormal=QVector::Zero();
+
+	ConvexPolygonCache *refPolygon=&cacheA;
+	ConvexPolygonCache *incPolygon=&cacheB;
+	for(int n=0;n<2;++n){
+		for(int i=0;i<refPolygon->axisCount;++i){
+			QVector sNormal=refPolygon->normals[i];
+			float refMin,refMax,incMin,incMax;
+			ProjectToAxis(sNormal,*refPolygon,refMin,refMax);
+			ProjectToAxis(sNormal,*incPolygon,incMin,incMax);
+
+			float penetration=incMin<refMin ? refMin-incMax : incMin-refMax;
+
+			if(penetration>=0){
+				cacheA.SaveSeparatingAxis(&cacheB,n,i,recordIndex);
+				return;
+			}
+
+			penetration=std::abs(penetration);
+
+			if(penetration<minPenetration){
+				minPenetration=penetration;
+				refNormal=sNormal;
+			}
+		}
+		refPolygon=&cacheB;
+		incPolygon=&cacheA;
+	}
+
+	//The polygons are colliding, the record is no longer useful.
+	if(recordIndex!=-1)
+		cacheA.separatingAxisRecords[recordIndex].otherPolygon=nullptr;
+
+	FindPolygonContacts(particlesA,particlesB,refNormal,contacts,findTwoSidedContacts);
+}
+
+bool QCollision::CheckIsCircleSeparatedFromPolygon(QParticle *circleParticle, ConvexPolygonCache &polygon)
+{
+	QVector center=circleParticle->GetGlobalPosition();
+	float radius=circleParticle->GetRadius();
+	for(int i=0;i<polygon.axisCount;++i){
+		QVector axis=polygon.normals[i];
+		float polygonMin,polygonMax;
+		ProjectToAxis(axis,polygon,polygonMin,polygonMax);
+		float centerDist=center.Dot(axis);
+		if(centerDist-radius>polygonMax || centerDist+radius<polygonMin){
+			return true;
+		}
+	}
+	return false;
+}
+
+bool QCollision::CheckArePolygonsSeparated(ConvexPolygonCache &polygonA, ConvexPolygonCache &polygonB)
+{
+	ConvexPolygonCache *refPolygon=&polygonA;
+	ConvexPolygonCache *incPolygon=&polygonB;
+	for(int n=0;n<2;++n){
+		for(int i=0;i<refPolygon->axisCount;++i){
+			QVector axis=refPolygon->normals[i];
+			float refMin,refMax,incMin,incMax;
+			ProjectToAxis(axis,*refPolygon,refMin,refMax);
+			ProjectToAxis(axis,*incPolygon,incMin,incMax);
+			if(incMin>=refMax || refMin>=incMax){
+				return true;
+			}
+		}
+		refPolygon=&polygonB;
+		incPolygon=&polygonA;
+	}
+	return false;
+}
 
+void QCollision::FindPolygonContacts(vector<QParticle *> &particlesA, vector<QParticle *> &particlesB, QVector refNormal, vector<QCollision::Contact *> &contacts, bool findTwoSidedContacts)
+{
+	int sizeparticlesA=particlesA.size();
+	int sizeparticlesB=particlesB.size();
 
 	//B. FIND INCIDENT AND REFERENCE OBJECT/SEGMENT ACCORDING TO NORMAL
 	QCollision::Project supportProjectA=ProjectToAxis(refNormal,particlesA);
@@ -1191,15 +1480,16 @@ void QCollision::PolygonAndPolygon(vector<QParticle *> &particlesA, vector<QPart
 	}
 
 	//Cliping and Adding contacts.
+	size_t contactsBegin=contacts.size();
 	if(segmentBParallelRate<segmentAParallelRate){
 		//The reference segment is segmentB
 		ClipContactParticles(segmentB,segmentA,contacts);
-		if(contacts.size()==0)
+		if(contacts.size()==contactsBegin || (findTwoSidedContacts && contacts.size()-contactsBegin<2) )
 			ClipContactParticles(segmentA,segmentB,contacts);
 	}else{
 		//The reference segment is segmentA
 		ClipContactParticles(segmentA,segmentB,contacts);
-		if(contacts.size()==0)
+		if(contacts.size()==contactsBegin || (findTwoSidedContacts && contacts.size()-contactsBegin<2) )
 			ClipContactParticles(segmentB,segmentA,contacts);
 	}
 }
@@ -1219,7 +1509,7 @@ void QCollision::ClipContactParticles(QParticle *referenceParticles[], QParticle
 			float proj=bv.Dot(unit);
 			if(proj>=0.0f && proj<=len){
 				QCollision::Contact *contact=QCollision::GetContactPool().Create().data;
-				contact->Configure(p,p->GetGlobalPosition(),normal,abs(dist), vector<QParticle*>{referenceParticles[0],referenceParticles[1]});
+				contact->Configure(p,p->GetGlobalPosition(),normal,abs(dist), referenceParticles[0],referenceParticles[1]);
 				contacts.push_back(contact); 
 
 			}
@@ -1231,6 +1521,35 @@ void QCollision::ClipContactParticles(QParticle *referenceParticles[], QParticle
 }
 
 
+void QCollision::ProjectToAxis(QVector &normal, ConvexPolygonCache &polygon, float &minDist, float &maxDist)
+{
+	//The projections are reduced in four separate running minimums and maximums, they're merged after the loops.
+	const float *xs=polygon.xs.data();
+	const float *ys=polygon.ys.data();
+	int polygonSize=polygon.xs.size();
+	float nx=normal.x;
+	float ny=normal.y;
+
+	float minLanes[4]={QWorld::MAX_WORLD_SIZE,QWorld::MAX_WORLD_SIZE,QWorld::MAX_WORLD_SIZE,QWorld::MAX_WORLD_SIZE};
+	float maxLanes[4]={-QWorld::MAX_WORLD_SIZE,-QWorld::MAX_WORLD_SIZE,-QWorld::MAX_WORLD_SIZE,-QWorld::MAX_WORLD_SIZE};
+	int i=0;
+	for(;i+4<=polygonSize;i+=4){
+		for(int k=0;k<4;++k){
+			float dist=xs[i+k]*nx+ys[i+k]*ny;
+			minLanes[k]=dist<minLanes[k] ? dist:minLanes[k];
+			maxLanes[k]=dist>maxLanes[k] ? dist:maxLanes[k];
+		}
+	}
+	for(;i<polygonSize;++i){
+		float dist=xs[i]*nx+ys[i]*ny;
+		minLanes[0]=dist<minLanes[0] ? dist:minLanes[0];
+		maxLanes[0]=dist>maxLanes[0] ? dist:maxLanes[0];
+	}
+
+	minDist=min(min(minLanes[0],minLanes[1]),min(minLanes[2],minLanes[3]) );
+	maxDist=max(max(maxLanes[0],maxLanes[1]),max(maxLanes[2],maxLanes[3]) );
+}
+
  QCollision::Project QCollision::ProjectToAxis(QVector &normal,vector<QParticle*> &polygon){
 	float minDist=QWorld::MAX_WORLD_SIZE;
 	float maxDist=-QWorld::MAX_WORLD_SIZE;
@@ -1329,7 +1648,7 @@ void QCollision::ClipContactParticles(QParticle *referenceParticles[], QParticle
      return res;
  }
 
- int QCollision::FindNearestParticleOfPolygon(QParticle* particle, vector<QParticle *> polygonParticles)
+ int QCollision::FindNearestParticleOfPolygon(QParticle* particle, const vector<QParticle *> &polygonParticles)
  {
 	int res=0;
 	float minDistance=QWorld::MAX_WORLD_SIZE;
@@ -1363,12 +1682,9 @@ void QCollision::ClipContactParticles(QParticle *referenceParticles[], QParticle
 	return res;
  }
 
- bool QCollision::PointInPolygonWN(const QVector point, vector<QParticle *> polygonParticles)
+ bool QCollision::PointInPolygonWN(const QVector point, const vector<QParticle *> &polygonParticles)
  {
 	//Winding number algorithm for the point in polygon operations
-     const QVector ray=QVector(QWorld::MAX_WORLD_SIZE,0.0f);
-	 const QVector rayPerp=QVector::Down();
-
 	 int windingNumber=0;
 
 	size_t polygonSize=polygonParticles.size();
@@ -1381,28 +1697,47 @@ void QCollision::ClipContactParticles(QParticle *referenceParticles[], QParticle
 		}else{
 			s2=polygonParticles[ i+1 ]->GetGlobalPosition();
 		}
-		//Broadphase: Checking whether the point is in the range of y positions of the side
-		if( point.y<=s1.y != point.y<=s2.y ){
-			QVector sideVec=s2-s1;
-			QVector sideVecPerp=sideVec.Perpendicular();
-			QVector s1ToPoint=s1-point;
-	
-			float t=s1ToPoint.Dot( sideVecPerp )/ray.Dot(sideVecPerp );
-			float u=(-s1ToPoint).Dot(rayPerp )/ sideVec.Dot(rayPerp);
-
-			//Checking intersection between the ray and the side vector
-			if( (t>=0.0 && t<=1.0) && (u>=0.0 && t<=1.0)  ){
+		windingNumber+=GetWindingNumberOfSide(point,s1,s2);
+	 }
 
-				if(sideVec.y<0 )
-					windingNumber-=1;
-				else 
-					windingNumber+=1;
-			}
+	 return windingNumber!=0;
+ }
 
+ int QCollision::GetWindingNumberOfSide(const QVector point, QVector s1, QVector s2)
+ {
+	const QVector ray=QVector(QWorld::MAX_WORLD_SIZE,0.0f);
+	const QVector rayPerp=QVector::Down();
+	//Broadphase: Checking whether the point is in the range of y positions of the side
+	if( point.y<=s1.y != point.y<=s2.y ){
+		QVector sideVec=s2-s1;
+		QVector sideVecPerp=sideVec.Perpendicular();
+		QVector s1ToPoint=s1-point;
+
+		float t=s1ToPoint.Dot( sideVecPerp )/ray.Dot(sideVecPerp );
+		float u=(-s1ToPoint).Dot(rayPerp )/ sideVec.Dot(rayPerp);
+
+		//Checking intersection between the ray and the side vector
+		if( (t>=0.0 && t<=1.0) && (u>=0.0 && t<=1.0)  ){
+
+			if(sideVec.y<0 )
+				return -1;
+			else 
+				return 1;
 		}
-	 }
 
-	 return windingNumber!=0;
+	}
+	return 0;
+ }
+
+ QMesh *QCollision::GetSegmentBVHMesh(vector<QParticle *> &polygonParticles)
+ {
+	//Brute force loops are faster for short polygons.
+	if(polygonParticles.size()<16)
+		return nullptr;
+	QMesh *mesh=polygonParticles[0]->GetOwnerMesh();
+	if(mesh==nullptr || &mesh->polygon!=&polygonParticles)
+		return nullptr;
+	return mesh;
  }
 
  QVector QCollision::LineIntersectionLine(QVector d1A, QVector d1B, QVector d2A, QVector d2B)
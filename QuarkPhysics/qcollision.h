@@ -31,10 +31,13 @@
 #include <vector>
 #include "qparticle.h"
 #include "qobjectpool.h"
+#include "qparticlegrid.h"
 
 
 class QWorld;
 class QAABB;
+class QMesh;
+class QBody;
 using namespace std;
 
 
@@ -60,29 +63,28 @@ public:
 		QVector normal;
 		/** The penetration of the collision */
 		float penetration;
-		/** The particle list of the reference face in the collision */
-		vector<QParticle*> referenceParticles;
+		/** The particles of the reference face in the collision. It holds a single particle for the point references and two particles for the segment references. Use referenceParticleCount to iterate over it. */
+		QParticle *referenceParticles[2];
+		/** The count of the reference particles in the collision.(1 or 2) */
+		int referenceParticleCount;
 		/** Determines whether the contact is solved. */
 		bool solved;
-		Contact(QParticle *particle,QVector position,QVector normal,float penetration,vector<QParticle*> referenceParticles ){
-			this->particle=particle;
-			this->position=position;
-			this->normal=normal;
-			this->penetration=penetration;
-			this->referenceParticles=referenceParticles;
-			this->solved=false;
+		Contact(QParticle *particle,QVector position,QVector normal,float penetration,QParticle *referenceParticleA,QParticle *referenceParticleB=nullptr ){
+			Configure(particle,position,normal,penetration,referenceParticleA,referenceParticleB);
 		}
 
 		Contact(){
 
 		}
 
-		void Configure(QParticle *particle,QVector position,QVector normal,float penetration,vector<QParticle*> referenceParticles){
+		void Configure(QParticle *particle,QVector position,QVector normal,float penetration,QParticle *referenceParticleA,QParticle *referenceParticleB=nullptr){
 			this->particle=particle;
 			this->position=position;
 			this->normal=normal;
 			this->penetration=penetration;
-			this->referenceParticles=referenceParticles;
+			this->referenceParticles[0]=referenceParticleA;
+			this->referenceParticles[1]=referenceParticleB;
+			this->referenceParticleCount=referenceParticleB==nullptr ? 1:2;
 			this->solved=false;
 		}
 
@@ -119,6 +121,52 @@ public:
 
 	};
 
+	/** @brief Contains the vertex positions and the edge normals of a convex polygon in a contiguous layout. Meshes keep one for each sub convex polygon and update it once per change, so the separating axis tests don't recompute them for each polygon pair. */
+	struct ConvexPolygonCache{
+		public:
+			/** The global x positions of the vertices. */
+			vector<float> xs;
+			/** The global y positions of the vertices. */
+			vector<float> ys;
+			/** The global edge normals. The normal at index i belongs to the edge between the vertices i and i+1. */
+			vector<QVector> normals;
+			/** The edge normals in the local space of the mesh. They're only used by rigid bodies. */
+			vector<QVector> localNormals;
+			/** The count of the normals to test as separating axes. Centrally symmetric polygons like boxes have pairs of opposite edge normals, so only the first half of their normals is tested. */
+			int axisCount=0;
+			/** The bounding box of the vertices. */
+			QAABB aabb;
+
+			/** @brief Keeps the last separating axis found against another polygon. The axis is defined by the side (0: this polygon, 1: the other polygon) and the edge index of the side. */
+			struct SeparatingAxisRecord{
+				ConvexPolygonCache *otherPolygon=nullptr;
+				int side=0;
+				int edgeIndex=0;
+			};
+			/** The last separating axes against the recently tested polygons. They're tested first in the next tests, since the same axis usually still separates the polygons. */
+			SeparatingAxisRecord separatingAxisRecords[8];
+			int nextSeparatingAxisRecord=0;
+
+			/** Returns the index of the separating axis record of the other polygon. If there isn't a record, returns -1. */
+			int FindSeparatingAxisRecord(ConvexPolygonCache *otherPolygon){
+				for(int i=0;i<8;++i){
+					if(separatingAxisRecords[i].otherPolygon==otherPolygon)
+						return i;
+				}
+				return -1;
+			}
+			/** Saves a separating axis against the other polygon. If the record index is -1, the oldest record is replaced. */
+			void SaveSeparatingAxis(ConvexPolygonCache *otherPolygon,int side,int edgeIndex,int recordIndex){
+				if(recordIndex==-1){
+					recordIndex=nextSeparatingAxisRecord;
+					nextSeparatingAxisRecord=(nextSeparatingAxisRecord+1)%8;
+				}
+				separatingAxisRecords[recordIndex].otherPolygon=otherPolygon;
+				separatingAxisRecords[recordIndex].side=side;
+				separatingAxisRecords[recordIndex].edgeIndex=edgeIndex;
+			}
+	};
+
 	
 
 	//Collision Methods
@@ -128,6 +176,15 @@ public:
 	 * @param contacts A collection where collision contact information will be stored.
 	 */
 	static void PolygonAndPolygon(vector<QParticle*> &particlesA,vector<QParticle*> &particlesB,vector<QCollision::Contact*> &contacts);
+	/** Checks collisions between polygons using their cached vertex positions and edge normals. 
+	 * @param particlesA A collection of particles that make up a polygon.
+	 * @param cacheA The convex polygon cache of particlesA.
+	 * @param particlesB Another collection of particles that make up a polygon.
+	 * @param cacheB The convex polygon cache of particlesB.
+	 * @param contacts A collection where collision contact information will be stored.
+	 * @param findTwoSidedContacts If true, the vertices of both polygons are clipped against the other polygon's contact segment. The impulse solver needs both corners of the resting pairs to resist rotation.
+	 */
+	static void PolygonAndPolygon(vector<QParticle*> &particlesA,ConvexPolygonCache &cacheA,vector<QParticle*> &particlesB,ConvexPolygonCache &cacheB,vector<QCollision::Contact*> &contacts,bool findTwoSidedContacts=false);
 	/** Checks collisions between circle(s) and polygon. 
 	 * @param circleParticles A collection of particles representing one or more circles, each having a radius.
 	 * @param polygonParticles A collection of particles that make up a polygon.
@@ -147,6 +204,19 @@ public:
 	 * @param contacts A collection where collision contact information will be stored.
 	 */
 	static void CircleAndCircleSelf(vector<QParticle*> &particles, vector<QCollision::Contact*> &contacts, float specifiedRadius=0.0f);
+	/** Checks collisions between circle(s) and the circles of a mesh with the neighbor cells of a particle grid. The particles must be the particle collection of a mesh, and both meshes must be in the grid.
+	 * @param particlesA The particle collection of a mesh representing one or more circles.
+	 * @param meshB The mesh of the other circles.
+	 * @param grid A particle grid that is built with the particles of both collections.
+	 * @param contacts A collection where collision contact information will be stored.
+	 */
+	static void CircleAndCircle(vector<QParticle*> &particlesA,QMesh *meshB,QParticleGrid &grid, QAABB boundingBoxB, vector<QCollision::Contact*> &contacts, float specifiedRadius=0.0f, bool velocitySensitive=false);
+	/** Checks the self collisions of all circles of a body with the neighbor cells of a particle grid. The contacts are solved immediately. 
+	 * @param body A body whose meshes are in the grid.
+	 * @param grid A particle grid that is built with the particles of the body.
+	 * @param contacts A collection where collision contact information will be stored temporarily.
+	 */
+	static void CircleAndCircleSelf(QBody *body,QParticleGrid &grid, vector<QCollision::Contact*> &contacts, float specifiedRadius=0.0f);
 	/** Checks collisions between polyline and polygon. 
 	 * @param polylineParticles A collection of particles that make up a polyline.
 	 * @param polygonParticles Another collection of particles that make up a polygon.
@@ -195,6 +265,18 @@ public:
 	 * @return Returns true if the point is inside the polygon, false otherwise.
 	 */
 	static bool PointInPolygon2(QVector point, vector<QParticle*> &polygon );
+	/** Checks whether a circle particle is separated from a convex polygon by one of the edge normals of the polygon. It's a cheap early out before the detailed circle and polygon tests.
+	 * @param circleParticle A particle representing a circle.
+	 * @param polygon The convex polygon cache of the polygon.
+	 * @return Returns true if a separating axis exists, false otherwise.
+	 */
+	static bool CheckIsCircleSeparatedFromPolygon(QParticle *circleParticle, ConvexPolygonCache &polygon);
+	/** Checks whether two convex polygons are separated by one of their edge normals. It doesn't create contacts, it's an early out for the convex hulls of concave meshes.
+	 * @param polygonA The convex polygon cache of the first polygon.
+	 * @param polygonB The convex polygon cache of the second polygon.
+	 * @return Returns true if a separating axis exists, false otherwise.
+	 */
+	static bool CheckArePolygonsSeparated(ConvexPolygonCache &polygonA, ConvexPolygonCache &polygonB);
 
 	
 	
@@ -203,11 +285,17 @@ private:
 	//Collision Helper Methods
 	static void ClipContactParticles(QParticle *referenceParticles[], QParticle *incidentParticles[], vector<QCollision::Contact*> &contacts );
 	static Project ProjectToAxis(QVector &normal,vector<QParticle*> &polygon);
+	static void ProjectToAxis(QVector &normal,ConvexPolygonCache &polygon,float &minDist,float &maxDist);
+	static vector<QParticle*> &GetParticlesSortedHorizontally(vector<QParticle*> &particles,vector<QParticle*> &sortedCopy);
+	static bool CreateCircleContact(QParticle *pA,QParticle *pB,float radiusA,float radiusB,bool velocitySensitive,vector<QCollision::Contact*> &contacts);
+	static void FindPolygonContacts(vector<QParticle*> &particlesA,vector<QParticle*> &particlesB,QVector refNormal,vector<QCollision::Contact*> &contacts,bool findTwoSidedContacts=false);
 	static vector<QVector> ParticlePolygonToPolygon(vector<QParticle*> particlePolygon);
 	static pair<int,int> FindNearestSideOfPolygon(const QVector point, vector<QParticle*> polygonParticles,bool checkSideRange=false, bool checkNegativeDistance=false);
-	static int FindNearestParticleOfPolygon(QParticle * particle, vector<QParticle*> polygonParticles);
+	static int FindNearestParticleOfPolygon(QParticle * particle, const vector<QParticle*> &polygonParticles);
 	static int FindExtremeParticleOfAxis(vector<QParticle*> polygonParticles, QVector axisNormal);
-	static bool PointInPolygonWN(const QVector point, vector<QParticle*> polygonParticles);
+	static bool PointInPolygonWN(const QVector point, const vector<QParticle*> &polygonParticles);
+	static int GetWindingNumberOfSide(const QVector point, QVector s1, QVector s2);
+	static QMesh *GetSegmentBVHMesh(vector<QParticle*> &polygonParticles);
 
 	
 
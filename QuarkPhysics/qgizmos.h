@@ -29,60 +29,100 @@
 #define QGIZMOS_H
 #include "qvector.h"
 #include "qaabb.h"
+#include <vector>
 
-class QGizmo
+using namespace std;
+
+/** @brief QGizmo is a plain debug shape record. The meaning of the points depends on the gizmo type:
+ * Circle: pointA is the center. Line: pointA and pointB are the end points. Rectangle: pointA and pointB are the min and max points.
+ */
+struct QGizmo
 {
-	public :
-		enum GizmoTypes{
-			Circle,
-			Line,
-			Rectangle
-		};
-	protected:
-		GizmoTypes gizmoType=GizmoTypes::Circle;
-	public:
-		
-		QGizmo(){
+	enum GizmoTypes{
+		Circle,
+		Line,
+		Rectangle
+	};
 
-		};
-		virtual ~QGizmo(){}
-		
-		GizmoTypes GetGizmoType(){
-			return gizmoType;
-		}
-};
-class QGizmoCircle:public QGizmo{
-	public:
-		float radius=0.0f;
-		QVector position=QVector::Zero();
-		QGizmoCircle(QVector pos,float rad ){
-			position=pos;
-			radius=rad;
-			gizmoType=GizmoTypes::Circle;
-		}
-};
+	GizmoTypes gizmoType=GizmoTypes::Circle;
+	QVector pointA=QVector::Zero();
+	QVector pointB=QVector::Zero();
+	float radius=0.0f;
+	bool isArrow=false;
 
-class QGizmoLine:public QGizmo{
-	public:
-		QVector pointA=QVector::Zero();
-		QVector pointB=QVector::Zero();
-		bool isArrow;
-		QGizmoLine(QVector from,QVector to,bool arrow=false ){
-			pointA=from;
-			pointB=to;
-			isArrow=arrow;
-			gizmoType=GizmoTypes::Line;
-		}
+	GizmoTypes GetGizmoType(){
+		return gizmoType;
+	}
 };
 
-class QGizmoRect:public QGizmo{
-	public:
-		QAABB rect;
-		
-		QGizmoRect( QAABB rectangle ){
-			rect=rectangle;
-			gizmoType=GizmoTypes::Rectangle;
-		}
+/** @brief QGizmoBuffer is a preallocated ring buffer of gizmos. Adding a gizmo never allocates, if the buffer is full, the oldest gizmo is overwritten. 
+ */
+class QGizmoBuffer
+{
+	vector<QGizmo> gizmos;
+	size_t head=0;
+	size_t count=0;
+
+	QGizmo &Add(QGizmo::GizmoTypes type){
+		QGizmo &gizmo=gizmos[head];
+		gizmo.gizmoType=type;
+		head=(head+1)%gizmos.size();
+		if(count<gizmos.size())
+			count+=1;
+		return gizmo;
+	}
+public:
+	QGizmoBuffer(size_t capacity=1024){
+		gizmos.resize(capacity);
+	}
+
+	/** Returns the count of the gizmos in the buffer. */
+	size_t GetCount(){
+		return count;
+	}
+	/** Returns the gizmo at the specified index. The index 0 is the oldest gizmo in the buffer. 
+	 * @param index The index of the gizmo.
+	 */
+	QGizmo &GetAt(size_t index){
+		size_t start=(head+gizmos.size()-count)%gizmos.size();
+		return gizmos[(start+index)%gizmos.size()];
+	}
+	/** Returns the maximum gizmo count of the buffer. */
+	size_t GetCapacity(){
+		return gizmos.size();
+	}
+	/** Sets the maximum gizmo count of the buffer. It clears the buffer. 
+	 * @param value A value to set. 
+	 */
+	void SetCapacity(size_t value){
+		gizmos.resize(value>0 ? value:1);
+		Clear();
+	}
+	/** Removes all gizmos in the buffer. */
+	void Clear(){
+		head=0;
+		count=0;
+	}
+
+	/** Adds a circle gizmo. */
+	void AddCircle(QVector position,float radius){
+		QGizmo &gizmo=Add(QGizmo::Circle);
+		gizmo.pointA=position;
+		gizmo.radius=radius;
+	}
+	/** Adds a line gizmo. */
+	void AddLine(QVector from,QVector to,bool isArrow=false){
+		QGizmo &gizmo=Add(QGizmo::Line);
+		gizmo.pointA=from;
+		gizmo.pointB=to;
+		gizmo.isArrow=isArrow;
+	}
+	/** Adds a rectangle gizmo. */
+	void AddRect(QAABB rect){
+		QGizmo &gizmo=Add(QGizmo::Rectangle);
+		gizmo.pointA=rect.GetMin();
+		gizmo.pointB=rect.GetMax();
+	}
 };
 
 
@@ -34,10 +34,21 @@
 #include "qmesh.h"
 #include "cmath"
 
+//Sequential Impulse Solver Properties
+//The rate of the penetration that is corrected in every iteration
+static const float impulseSolverPositionCorrectionRate=0.2f;
+//The penetration amount that is allowed without position correction. It keeps the resting contacts alive between the steps.
+static const float impulseSolverPenetrationSlop=0.5f;
+//The minimum approach velocity to apply restitution
+static const float impulseSolverRestitutionThreshold=1.0f;
 
 
-QManifold::QManifold(QBody *bodyA, QBody *bodyB)
+QManifold::QManifold(QBody *bodyA, QBody *bodyB,vector<QCollision::Contact*> *contactStream,size_t contactsBegin,size_t contactCount)
 {
+	this->contactStream=contactStream;
+	this->contactsBegin=contactsBegin;
+	this->contactCount=contactCount;
+
 	if(bodyA<bodyB){
 		this->bodyA=bodyA;
 		this->bodyB=bodyB;
@@ -57,13 +68,22 @@ QManifold::QManifold(QBody *bodyA, QBody *bodyB)
 		isCollisionOneSide=true;
 	}
 
+	//The impulse solver only works between rigid bodies. Static bodies of any type only give response.
+	isImpulseSolvable=bodyA->GetSimulationModel()==QBody::SimulationModels::RIGID_BODY && bodyB->GetSimulationModel()==QBody::SimulationModels::RIGID_BODY;
+	if(bodyA->GetBodyType()!=QBody::BodyTypes::RIGID && bodyA->GetMode()!=QBody::Modes::STATIC)
+		isImpulseSolvable=false;
+	if(bodyB->GetBodyType()!=QBody::BodyTypes::RIGID && bodyB->GetMode()!=QBody::Modes::STATIC)
+		isImpulseSolvable=false;
+	if(bodyA->GetBodyType()==QBody::BodyTypes::AREA || bodyB->GetBodyType()==QBody::BodyTypes::AREA)
+		isImpulseSolvable=false;
+
 
 
 }
 
 
 
-QVector QManifold::GetRelativeVelocity(QParticle *contactParticle,vector<QParticle*> referenceParticles,QVector rRef, QVector rInc)
+QVector QManifold::GetRelativeVelocity(QParticle *contactParticle,QParticle * const referenceParticles[],int referenceParticleCount,QVector rRef, QVector rInc)
 {
 
 	QBody *bodyRef=referenceParticles[0]->GetOwnerMesh()->GetOwnerBody();
@@ -80,11 +100,11 @@ QVector QManifold::GetRelativeVelocity(QParticle *contactParticle,vector<QPartic
 		velRef=bodyRef->GetPosition()-bodyRef->GetPreviousPosition();
 	}else{
 		//For SoftBodies
-		for(int i=0;i<referenceParticles.size();i++){
+		for(int i=0;i<referenceParticleCount;i++){
 			auto p=referenceParticles[i];
 			velRef+=p->GetGlobalPosition()-p->GetPreviousGlobalPosition();
 		}
-		velRef/=referenceParticles.size();
+		velRef/=referenceParticleCount;
 
 	}
 
@@ -105,6 +125,116 @@ QVector QManifold::GetRelativeVelocity(QParticle *contactParticle,vector<QPartic
 
 
 
+bool QManifold::CheckContactCanBeSolved(QCollision::Contact *contact, QBody *referenceBody, QBody *incidentBody, bool &incidentParticleIsLazy, bool &referenceParticlesAreLazy)
+{
+	bool cancelSolving=false;
+
+	//Checking Area Bodies
+
+	if(referenceBody->GetBodyType()==QBody::BodyTypes::AREA){
+		QAreaBody *refAreaBody=static_cast<QAreaBody*>(referenceBody);
+		refAreaBody->AddCollidedBody(incidentBody);
+		cancelSolving=true;
+	}
+
+	if(incidentBody->GetBodyType()==QBody::BodyTypes::AREA){
+		QAreaBody *incAreaBody=static_cast<QAreaBody*>(incidentBody);
+		incAreaBody->AddCollidedBody(referenceBody);
+		cancelSolving=true;
+	}
+
+	//Calling Events
+
+	QBody::CollisionInfo colInfoRef(contact->position,incidentBody,-contact->normal,contact->penetration);
+	bool collisionEnabledByRef=referenceBody->OnCollision(colInfoRef);
+	if(referenceBody->CollisionEventListener!=nullptr){
+		bool listenerResult=referenceBody->CollisionEventListener(referenceBody,colInfoRef);
+		if(collisionEnabledByRef==true)
+			collisionEnabledByRef=listenerResult;
+	}
+
+
+
+	QBody::CollisionInfo colInfoInc(contact->position,referenceBody,contact->normal,contact->penetration);
+	bool collisionEnabledByInc=incidentBody->OnCollision(colInfoInc);
+	if(incidentBody->CollisionEventListener!=nullptr){
+		bool listenerResult=incidentBody->CollisionEventListener(incidentBody,colInfoInc);
+		if(collisionEnabledByInc==true)
+			collisionEnabledByInc=listenerResult;
+	}
+
+	
+	//Exceptions of Returns of Events.
+
+	if(collisionEnabledByRef==false || collisionEnabledByInc==false){
+		cancelSolving=true;
+	}
+
+
+	if(cancelSolving==true)
+		return false;
+
+
+	//Exceptions of Disabled Particles
+	if(contact->particle->GetEnabled()==false  )
+		return false;
+
+	for (int n=0;n<contact->referenceParticleCount;++n ){
+		if (contact->referenceParticles[n]->GetEnabled()==false ){
+			cancelSolving=true;
+			break;
+		}
+			
+	}
+
+	if(cancelSolving==true)
+		return false;
+
+
+
+	
+
+	
+
+	//Exceptions of Lazy Particles
+	incidentParticleIsLazy=false;
+	referenceParticlesAreLazy=false;
+	if (contact->particle->GetIsLazy() ){
+		contact->particle->previousCollidedBodies.Insert(referenceBody);
+		incidentParticleIsLazy=true;
+		isCollisionOneSide=true;
+	}
+
+	for (int n=0;n<contact->referenceParticleCount;++n ){
+		if (contact->referenceParticles[n]->GetIsLazy() ){
+			contact->referenceParticles[n]->previousCollidedBodies.Insert(incidentBody);
+			isCollisionOneSide=true;
+			referenceParticlesAreLazy=true;
+		}
+	}
+
+	if (contact->particle->GetIsLazy() ){
+		if( contact->particle->oneTimeCollidedBodies.Contains(referenceBody) ){
+			return false;
+		}
+	}
+	
+	for (int n=0;n<contact->referenceParticleCount;++n ){
+		if (contact->referenceParticles[n]->GetIsLazy() ){
+			if( contact->referenceParticles[n]->oneTimeCollidedBodies.Contains(incidentBody) ){
+				cancelSolving=true;
+				break;
+			}
+		}
+			
+	}
+
+	if(cancelSolving==true)
+		return false;
+
+	return true;
+}
+
 void QManifold::Solve()
 {
 
@@ -124,8 +254,8 @@ void QManifold::Solve()
 	
 
 
-	for(int i=0;i<contacts.size();i++){
-		QCollision::Contact *contact=contacts[i];
+	for(size_t i=0;i<contactCount;i++){
+		QCollision::Contact *contact=GetContactAt(i);
 
 		
 
@@ -142,11 +272,12 @@ void QManifold::Solve()
 			responseForce*=2.0f;
 
 		if(betweenRigidbodies==true)
-			responseForce/=contacts.size();
+			responseForce/=contactCount;
 
 
 
-		bodyA->GetWorld()->gizmos.push_back( new QGizmoRect( QAABB(contact->position+QVector(-0.5f,-0.5f) ,contact->position+QVector(0.5f,0.5f) ) ));
+		if(bodyA->GetWorld()->enableDebugGizmos)
+			bodyA->GetWorld()->gizmos.AddRect( QAABB(contact->position+QVector(-0.5f,-0.5f) ,contact->position+QVector(0.5f,0.5f) ) );
 
 
 
@@ -173,7 +304,7 @@ void QManifold::Solve()
 		QVector rInc=contact->position-incidentBody->GetPosition();
 
 		if(i==0){
-			linearRelativeVelocity=GetRelativeVelocity(contact->particle,contact->referenceParticles,rRef,rInc);
+			linearRelativeVelocity=GetRelativeVelocity(contact->particle,contact->referenceParticles,contact->referenceParticleCount,rRef,rInc);
 		}
 
 
@@ -182,114 +313,12 @@ void QManifold::Solve()
 
 
 
-		bool cancelSolving=false;
-
-		//Checking Area Bodies
-
-		if(referenceBody->GetBodyType()==QBody::BodyTypes::AREA){
-			QAreaBody *refAreaBody=static_cast<QAreaBody*>(referenceBody);
-			refAreaBody->AddCollidedBody(incidentBody);
-			cancelSolving=true;
-		}
-	
-		if(incidentBody->GetBodyType()==QBody::BodyTypes::AREA){
-			QAreaBody *incAreaBody=static_cast<QAreaBody*>(incidentBody);
-			incAreaBody->AddCollidedBody(referenceBody);
-			cancelSolving=true;
-		}
-
-		//Calling Events
-
-		QBody::CollisionInfo colInfoRef(contact->position,incidentBody,-contact->normal,contact->penetration);
-		bool collisionEnabledByRef=referenceBody->OnCollision(colInfoRef);
-		if(referenceBody->CollisionEventListener!=nullptr){
-			bool listenerResult=referenceBody->CollisionEventListener(referenceBody,colInfoRef);
-			if(collisionEnabledByRef==true)
-				collisionEnabledByRef=listenerResult;
-		}
-
-
-
-		QBody::CollisionInfo colInfoInc(contact->position,referenceBody,contact->normal,contact->penetration);
-		bool collisionEnabledByInc=incidentBody->OnCollision(colInfoInc);
-		if(incidentBody->CollisionEventListener!=nullptr){
-			bool listenerResult=incidentBody->CollisionEventListener(incidentBody,colInfoInc);
-			if(collisionEnabledByInc==true)
-				collisionEnabledByInc=listenerResult;
-		}
-
-		
-		//Exceptions of Returns of Events.
-
-		if(collisionEnabledByRef==false || collisionEnabledByInc==false){
-			cancelSolving=true;
-		}
-
-
-		if(cancelSolving==true)
-			continue;
-
-
-		//Exceptions of Disabled Particles
-		if(contact->particle->GetEnabled()==false  )
-			continue;
-
-		for (size_t n=0;n<contact->referenceParticles.size();++n ){
-			if (contact->referenceParticles[n]->GetEnabled()==false ){
-				cancelSolving=true;
-				break;
-			}
-				
-		}
-
-		if(cancelSolving==true)
-			continue;
-
-
-
-		
-
-		
-
-		//Exceptions of Lazy Particles
+		//Area bodies, collision events, disabled and lazy particles
 		bool incidentParticleIsLazy=false;
 		bool referenceParticlesAreLazy=false;
-		if (contact->particle->GetIsLazy() ){
-			contact->particle->previousCollidedBodies.insert(referenceBody);
-			incidentParticleIsLazy=true;
-			isCollisionOneSide=true;
-		}
-
-		for (size_t n=0;n<contact->referenceParticles.size();++n ){
-			if (contact->referenceParticles[n]->GetIsLazy() ){
-				contact->referenceParticles[n]->previousCollidedBodies.insert(incidentBody);
-				isCollisionOneSide=true;
-				referenceParticlesAreLazy=true;
-			}
-		}
-
-		if (contact->particle->GetIsLazy() ){
-			if( contact->particle->oneTimeCollidedBodies.find(referenceBody)!=contact->particle->oneTimeCollidedBodies.end() ){
-				continue;
-			}
-		}
-		
-		for (size_t n=0;n<contact->referenceParticles.size();++n ){
-			if (contact->referenceParticles[n]->GetIsLazy() ){
-				if( contact->referenceParticles[n]->oneTimeCollidedBodies.find(incidentBody)!=contact->referenceParticles[n]->oneTimeCollidedBodies.end()  )
-					cancelSolving=true;
-					break;
-			}
-				
-		}
-
-		if(cancelSolving==true)
+		if(CheckContactCanBeSolved(contact,referenceBody,incidentBody,incidentParticleIsLazy,referenceParticlesAreLazy)==false)
 			continue;
 
-		
-
-
-
 		//APPLYING FORCES TO BODIES
 		QVector refResponseForce;
 		QVector incResponseForce;
@@ -311,7 +340,7 @@ void QManifold::Solve()
 				refRigidBody->ApplyForce(refResponseForce,rRef,true);
 			}else{
 				//For Softbodies
-				if(contact->referenceParticles.size()==2){
+				if(contact->referenceParticleCount==2){
 					QParticle::ApplyForceToParticleSegment(contact->referenceParticles[0],contact->referenceParticles[1],refResponseForce,contact->position );
 				}else{
 					contact->referenceParticles[0]->ApplyForce(refResponseForce);
@@ -351,8 +380,8 @@ void QManifold::SolveFrictionAndVelocities()
 		return;
 
 
-	for(int i=0;i<contacts.size();i++){
-		QCollision::Contact *contact=contacts[i];
+	for(size_t i=0;i<contactCount;i++){
+		QCollision::Contact *contact=GetContactAt(i);
 		//Don't apply friction and velocity to not solved contacts
 		if(contact->solved==false) continue;
 
@@ -379,7 +408,7 @@ void QManifold::SolveFrictionAndVelocities()
 		if(i==0 && restitution>0.0f){
 			auto j=linearRelativeVelocity.Dot(contact->normal);//+contact->prevImpulseScalar;
 			if(j>restitution*2.0f){
-				relVel=GetRelativeVelocity(contact->particle,contact->referenceParticles,QVector::Zero(),QVector::Zero());
+				relVel=GetRelativeVelocity(contact->particle,contact->referenceParticles,contact->referenceParticleCount,QVector::Zero(),QVector::Zero());
 				QVector tangent=relVel-(relVel.Dot(contact->normal)*contact->normal );
 				auto jn=(j*contact->normal)*restitution-tangent;
 
@@ -417,7 +446,7 @@ void QManifold::SolveFrictionAndVelocities()
 		//FRICTIONS
 
 
-		relVel=GetRelativeVelocity(contact->particle,contact->referenceParticles,rRef,rInc);
+		relVel=GetRelativeVelocity(contact->particle,contact->referenceParticles,contact->referenceParticleCount,rRef,rInc);
 		QVector frictionForce=QBody::ComputeFriction(incidentBody,referenceBody,contact->normal,contact->penetration,relVel);
 
 		QVector refResponseForce;
@@ -442,7 +471,7 @@ void QManifold::SolveFrictionAndVelocities()
 
 			}else{
 				//For Softbodies
-				if(contact->referenceParticles.size()==2){
+				if(contact->referenceParticleCount==2){
 					QParticle::ApplyForceToParticleSegment(contact->referenceParticles[0],contact->referenceParticles[1],refResponseForce,contact->particle->GetGlobalPosition());
 				}else{
 					contact->referenceParticles[0]->ApplyForce(refResponseForce);
@@ -470,10 +499,158 @@ void QManifold::SolveFrictionAndVelocities()
 
 }
 
+QVector QManifold::GetPointVelocity(QBody *body, QVector r)
+{
+	QVector vel=body->GetPosition()-body->GetPreviousPosition();
+	float angVel=body->GetRotation()-body->GetPreviousRotation();
+	return vel+angVel*-r.Perpendicular();
+}
 
+void QManifold::ApplyContactImpulse(QBody *body, float invMass, QVector impulse, QVector r, bool changeVelocity)
+{
+	if(invMass==0.0f)
+		return;
+	QRigidBody *rigidBody=static_cast<QRigidBody*>(body);
+	QVector displacement=impulse*invMass;
+	//The positions are already integrated in the step, so a velocity change moves the body too.
+	rigidBody->ApplyForce(displacement,r,false);
+	if(changeVelocity==false){
+		//Split impulses move the body without changing its velocity.
+		rigidBody->AddPreviousPosition(displacement);
+		if(rigidBody->GetFixedRotationEnabled()==false)
+			rigidBody->AddPreviousRotation(r.Dot(displacement.Perpendicular())/rigidBody->GetInertia() );
+	}
+}
 
+void QManifold::PrepareImpulses(vector<ImpulseContact> *impulseContactStream, bool warmStart)
+{
+	QWorld *world=bodyA->GetWorld();
+	this->impulseContactStream=impulseContactStream;
+	impulseContactsBegin=impulseContactStream->size();
+	impulseContactCount=0;
 
+	for(size_t i=0;i<contactCount;i++){
+		QCollision::Contact *contact=GetContactAt(i);
+		contact->penetration=max(contact->penetration,0.0f);
 
+		if(world->enableDebugGizmos)
+			world->gizmos.AddRect( QAABB(contact->position+QVector(-0.5f,-0.5f) ,contact->position+QVector(0.5f,0.5f) ) );
 
+		QBody *referenceBody=contact->referenceParticles[0]->GetOwnerMesh()->GetOwnerBody();
+		QBody *incidentBody=contact->particle->GetOwnerMesh()->GetOwnerBody();
 
+		//Area bodies, collision events, disabled and lazy particles
+		bool incidentParticleIsLazy=false;
+		bool referenceParticlesAreLazy=false;
+		if(CheckContactCanBeSolved(contact,referenceBody,incidentBody,incidentParticleIsLazy,referenceParticlesAreLazy)==false)
+			continue;
 
+		//The bodies that can't take response have zero inverse mass.
+		ImpulseContact ic;
+		ic.contact=contact;
+		ic.referenceBody=referenceBody;
+		ic.incidentBody=incidentBody;
+		float invInertiaRef=0.0f;
+		float invInertiaInc=0.0f;
+		if(incidentBody->CanGiveCollisionResponseTo(referenceBody) && incidentParticleIsLazy==false && referenceBody->GetBodyType()==QBody::BodyTypes::RIGID){
+			ic.invMassRef=1.0f/referenceBody->GetMass();
+			if(static_cast<QRigidBody*>(referenceBody)->GetFixedRotationEnabled()==false)
+				invInertiaRef=ic.invMassRef/referenceBody->GetInertia();
+		}
+		if(referenceBody->CanGiveCollisionResponseTo(incidentBody) && referenceParticlesAreLazy==false && incidentBody->GetBodyType()==QBody::BodyTypes::RIGID){
+			ic.invMassInc=1.0f/incidentBody->GetMass();
+			if(static_cast<QRigidBody*>(incidentBody)->GetFixedRotationEnabled()==false)
+				invInertiaInc=ic.invMassInc/incidentBody->GetInertia();
+		}
+		if(ic.invMassRef==0.0f && ic.invMassInc==0.0f)
+			continue;
+		contact->solved=incidentParticleIsLazy==false && referenceParticlesAreLazy==false;
+
+		QVector normal=contact->normal;
+		QVector tangent=normal.Perpendicular();
+		ic.rRef=contact->position-referenceBody->GetPosition();
+		ic.rInc=contact->position-incidentBody->GetPosition();
+
+		float rnRef=ic.rRef.Dot(normal.Perpendicular());
+		float rnInc=ic.rInc.Dot(normal.Perpendicular());
+		ic.normalMass=ic.invMassRef+ic.invMassInc+invInertiaRef*rnRef*rnRef+invInertiaInc*rnInc*rnInc;
+		float rtRef=ic.rRef.Dot(tangent.Perpendicular());
+		float rtInc=ic.rInc.Dot(tangent.Perpendicular());
+		ic.tangentMass=ic.invMassRef+ic.invMassInc+invInertiaRef*rtRef*rtRef+invInertiaInc*rtInc*rtInc;
+
+		//The contacts are only used for the position corrections after the first iteration.
+		bool isFirstInStep=false;
+		if(warmStart)
+			ic.accumulated=&world->GetAccumulatedImpulse(contact,isFirstInStep);
+
+		if(isFirstInStep){
+			float normalVelocity=(GetPointVelocity(incidentBody,ic.rInc)-GetPointVelocity(referenceBody,ic.rRef) ).Dot(normal);
+			ic.accumulated->velocityBias=normalVelocity<-impulseSolverRestitutionThreshold ? -restitution*normalVelocity : 0.0f;
+
+			//Warm Starting
+			QVector impulse=normal*ic.accumulated->normalImpulse+tangent*ic.accumulated->tangentImpulse;
+			ApplyContactImpulse(referenceBody,ic.invMassRef,-impulse,ic.rRef,true);
+			ApplyContactImpulse(incidentBody,ic.invMassInc,impulse,ic.rInc,true);
+		}
+
+		impulseContactStream->push_back(ic);
+		impulseContactCount+=1;
+	}
+}
+
+void QManifold::SolveImpulses()
+{
+	if(impulseContactCount==0)
+		return;
+	float dynamicFriction=min(bodyA->friction,bodyB->friction);
+	float staticFriction=sqrt(bodyA->staticFriction*bodyB->staticFriction);
+
+	for(size_t i=0;i<impulseContactCount;i++){
+		ImpulseContact &ic=(*impulseContactStream)[impulseContactsBegin+i];
+		QCollision::Contact *contact=ic.contact;
+		AccumulatedImpulse &accumulated=*ic.accumulated;
+		QVector normal=contact->normal;
+		QVector tangent=normal.Perpendicular();
+
+		//Normal Impulse
+		float normalVelocity=(GetPointVelocity(ic.incidentBody,ic.rInc)-GetPointVelocity(ic.referenceBody,ic.rRef) ).Dot(normal);
+		float deltaImpulse=(accumulated.velocityBias-normalVelocity)/ic.normalMass;
+		float newImpulse=max(accumulated.normalImpulse+deltaImpulse,0.0f);
+		deltaImpulse=newImpulse-accumulated.normalImpulse;
+		accumulated.normalImpulse=newImpulse;
+		ApplyContactImpulse(ic.referenceBody,ic.invMassRef,-normal*deltaImpulse,ic.rRef,true);
+		ApplyContactImpulse(ic.incidentBody,ic.invMassInc,normal*deltaImpulse,ic.rInc,true);
+
+		//Friction Impulse
+		float tangentVelocity=(GetPointVelocity(ic.incidentBody,ic.rInc)-GetPointVelocity(ic.referenceBody,ic.rRef) ).Dot(tangent);
+		deltaImpulse=-tangentVelocity/ic.tangentMass;
+		newImpulse=accumulated.tangentImpulse+deltaImpulse;
+		if(abs(newImpulse)>staticFriction*accumulated.normalImpulse){
+			float maxImpulse=dynamicFriction*accumulated.normalImpulse;
+			newImpulse=max(-maxImpulse,min(newImpulse,maxImpulse) );
+		}
+		deltaImpulse=newImpulse-accumulated.tangentImpulse;
+		accumulated.tangentImpulse=newImpulse;
+		ApplyContactImpulse(ic.referenceBody,ic.invMassRef,-tangent*deltaImpulse,ic.rRef,true);
+		ApplyContactImpulse(ic.incidentBody,ic.invMassInc,tangent*deltaImpulse,ic.rInc,true);
+	}
+}
+
+void QManifold::SolvePositionErrors()
+{
+	for(size_t i=0;i<impulseContactCount;i++){
+		ImpulseContact &ic=(*impulseContactStream)[impulseContactsBegin+i];
+		float correction=impulseSolverPositionCorrectionRate*(ic.contact->penetration-impulseSolverPenetrationSlop);
+		if(correction>0.0f){
+			QVector impulse=ic.contact->normal*(correction/ic.normalMass);
+			ApplyContactImpulse(ic.referenceBody,ic.invMassRef,-impulse,ic.rRef,false);
+			ApplyContactImpulse(ic.incidentBody,ic.invMassInc,impulse,ic.rInc,false);
+			ic.contact->penetration-=correction;
+		}
+	}
+
+	if(bodyA->GetBodyType()==QBody::BodyTypes::RIGID && bodyA->GetMode()!=QBody::Modes::STATIC)
+		bodyA->UpdateMeshTransforms();
+	if(bodyB->GetBodyType()==QBody::BodyTypes::RIGID && bodyB->GetMode()!=QBody::Modes::STATIC)
+		bodyB->UpdateMeshTransforms();
+}
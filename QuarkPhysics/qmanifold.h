@@ -29,33 +29,68 @@
 #define QMANIFOLD_H
 #include "qbody.h"
 #include "qcollision.h"
+#include <unordered_map>
 /** 
  * @brief QManifold retrieves collision data from collision tests between two QBody objects using QCollision methods and resolves collisions based on this data. The Solve() method applies collision reactions by changing the positions of contact partners, while the SolveFrictionAndVelocities() method applies friction to the contact partners and adjusts their velocity values.
  */
 class QManifold
 {
-	QVector GetRelativeVelocity(QParticle *contactParticle,vector<QParticle*> referenceParticles, QVector rRef,QVector rInc);
+	QVector GetRelativeVelocity(QParticle *contactParticle,QParticle * const referenceParticles[],int referenceParticleCount, QVector rRef,QVector rInc);
 	QVector linearRelativeVelocity=QVector::Zero();
 
 	//One time calculate properties
 	float restitution=0.0f;
 	float invMass;
 	bool isCollisionOneSide=false;
+	bool isImpulseSolvable=false;
+
+	bool CheckContactCanBeSolved(QCollision::Contact *contact,QBody *referenceBody,QBody *incidentBody,bool &incidentParticleIsLazy,bool &referenceParticlesAreLazy);
+
+	//Sequential Impulse Solver
+	static QVector GetPointVelocity(QBody *body,QVector r);
+	static void ApplyContactImpulse(QBody *body,float invMass,QVector impulse,QVector r,bool changeVelocity);
 public:
+	/** The accumulated impulses of a contact in a physics step. They're kept to warm start the sequential impulse solver in the next step. */
+	struct AccumulatedImpulse{
+		/** The accumulated impulse along the normal of the contact. */
+		float normalImpulse=0.0f;
+		/** The accumulated impulse along the tangent of the contact. */
+		float tangentImpulse=0.0f;
+		/** The target normal velocity of the contact. It's computed from the restitution once per step. */
+		float velocityBias=0.0f;
+	};
 
 
 	/**
-	 * Creates new manifold with two bodies.
+	 * Creates new manifold with two bodies. The contacts of the manifold are a range of a contact stream. 
 	 * @param bodyA A body in the world.
 	 * @param bodyB Another body in the world. 
+	 * @param contactStream A contact collection that the contacts of the manifold are stored in.
+	 * @param contactsBegin The index of the first contact of the manifold in the contact stream.
+	 * @param contactCount The count of the contacts of the manifold.
 	 */
-	QManifold(QBody *bodyA,QBody *bodyB);
+	QManifold(QBody *bodyA,QBody *bodyB,vector<QCollision::Contact*> *contactStream,size_t contactsBegin,size_t contactCount);
 
 	QBody *bodyA;
 	QBody *bodyB;
 
-	/** The collection of contacs from collision test using QCollision methods. */
-	vector<QCollision::Contact*> contacts;
+	/** The contact stream that the contacts of the manifold are stored in. Contacts of the manifolds in the world are valid until the next physics step. */
+	vector<QCollision::Contact*> *contactStream;
+	/** The index of the first contact of the manifold in the contact stream. */
+	size_t contactsBegin;
+	/** The count of the contacts of the manifold. */
+	size_t contactCount;
+
+	/** Returns the count of the contacts of the manifold. */
+	size_t GetContactCount(){
+		return contactCount;
+	}
+	/** Returns the contact at the specified index of the manifold. 
+	 * @param index The index of the contact in the manifold.
+	 */
+	QCollision::Contact *GetContactAt(size_t index){
+		return (*contactStream)[contactsBegin+index];
+	}
 
 	/** Applies collision reactions by changing the positions of the contact partners. */
 	void Solve();
@@ -63,6 +98,43 @@ public:
 	/** Applies friction to the contact partners and adjust their velocity values */
 	void SolveFrictionAndVelocities();
 
+	/** Returns whether the contacts of the manifold can be solved with the sequential impulse solver. It's only possible between rigid bodies, the other manifolds are always solved with the positional solver. */
+	bool GetIsImpulseSolvable(){
+		return isImpulseSolvable;
+	}
+
+	/** The solver data of a contact that is solved with the sequential impulse solver. They're stored in a stream of the world, and they're valid in a solver iteration. */
+	struct ImpulseContact{
+		QCollision::Contact *contact=nullptr;
+		QBody *referenceBody=nullptr;
+		QBody *incidentBody=nullptr;
+		float invMassRef=0.0f;
+		float invMassInc=0.0f;
+		QVector rRef=QVector::Zero();
+		QVector rInc=QVector::Zero();
+		/** The inverse effective masses of the contact along its normal and its tangent. */
+		float normalMass=0.0f;
+		float tangentMass=0.0f;
+		AccumulatedImpulse *accumulated=nullptr;
+	};
+
+	/** Prepares the contacts of the manifold for the sequential impulse solver. 
+	 * @param impulseContactStream A collection that the solver data of the contacts are stored in.
+	 * @param warmStart If true, the accumulated impulses of the contacts are fetched, and the impulses of the previous step are applied to the bodies. It should be true only for the contacts that SolveImpulses() will be called with.
+	 */
+	void PrepareImpulses(vector<ImpulseContact> *impulseContactStream,bool warmStart);
+
+	/** Applies collision reactions and friction as accumulated impulses on the velocity level. The impulses of the contacts are kept in the world between the solver iterations and the steps. The normal impulses never pull the bodies together, and the friction impulses are clamped by the normal impulses. */
+	void SolveImpulses();
+
+	/** Corrects the penetrations of the contacts prepared with PrepareImpulses(). It only changes the positions of the bodies (split impulses), so the corrections don't add velocity to the bodies. */
+	void SolvePositionErrors();
+
+private:
+	//The solver data range of the manifold in the impulse contact stream
+	vector<ImpulseContact> *impulseContactStream=nullptr;
+	size_t impulseContactsBegin=0;
+	size_t impulseContactCount=0;
 
 };
 
@@ -91,4 +163,30 @@ inline bool operator <(const QManifoldKey& mk1,const QManifoldKey& mk2){
 	return false;
 }
 
+/** The key of a contact between the iterations and the steps. A contact is identified by its incident particle and the particles of its reference face. */
+struct QContactKey{
+public:
+	QContactKey(QCollision::Contact *contact){
+		particle=contact->particle;
+		referenceParticleA=contact->referenceParticles[0];
+		referenceParticleB=contact->referenceParticleCount==2 ? contact->referenceParticles[1]:nullptr;
+	}
+	QParticle *particle;
+	QParticle *referenceParticleA;
+	QParticle *referenceParticleB;
+};
+
+inline bool operator ==(const QContactKey& ck1,const QContactKey& ck2){
+	return ck1.particle==ck2.particle && ck1.referenceParticleA==ck2.referenceParticleA && ck1.referenceParticleB==ck2.referenceParticleB;
+}
+
+struct QContactKeyHash{
+	size_t operator()(const QContactKey& ck) const {
+		size_t h=std::hash<QParticle*>{}(ck.particle);
+		h^=std::hash<QParticle*>{}(ck.referenceParticleA)+0x9e3779b9+(h<<6)+(h>>2);
+		h^=std::hash<QParticle*>{}(ck.referenceParticleB)+0x9e3779b9+(h<<6)+(h>>2);
+		return h;
+	}
+};
+
 #endif // QMANIFOLD_H
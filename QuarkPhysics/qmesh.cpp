@@ -35,9 +35,36 @@
 #include <string>
 #include "qcollision.h"
 #include "qworld.h"
-#include "polypartition/polypartition.h"
-#include <list>
+#include <algorithm>
+#include <limits>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+
+//The over relaxation factor of the averaged corrections of the packed springs and angle constraints.
+static const float packedConstraintsRelaxation=1.8f;
+
+//An atan2 approximation with a polynomial instead of trigonometric calls, its maximum error is about 1e-5 radians.
+static inline float ApproximateAtan2(float y,float x){
+	float absX=fabs(x);
+	float absY=fabs(y);
+	float maxValue=absX>absY ? absX:absY;
+	float minValue=absX>absY ? absY:absX;
+	float a=maxValue>0.0f ? minValue/maxValue:0.0f;
+	float s=a*a;
+	float r=((-0.0464964749f*s+0.15931422f)*s-0.327622764f)*s*a+a;
+	r=absY>absX ? 1.57079637f-r:r;
+	r=x<0.0f ? 3.14159274f-r:r;
+	return y<0.0f ? -r:r;
+}
 
+//The floor function with an integer conversion, it doesn't call the math library.
+static inline float ApproximateFloor(float x){
+	float t=(float)(int)x;
+	return t>x ? t-1.0f:t;
+}
 
 QMesh::QMesh(){
 }
@@ -106,6 +133,10 @@ QMesh *QMesh::AddParticle(QParticle *particle){
 		ownerBody->circumferenceNeedsUpdate=true;
 	}
 	collisionBehaviorNeedsUpdate=true;
+	sortedParticlesNeedsRebuild=true;
+	springAdjacencyNeedsRebuild=true;
+	shapeMatchingRestPositionsNeedsUpdate=true;
+	localBoundsNeedsUpdate=true;
 	return this;
 }
 
@@ -124,6 +155,10 @@ QMesh *QMesh::RemoveParticleAt(int index){
 	}
 	collisionBehaviorNeedsUpdate=true;
 	polygonBisectorsNeedsUpdate=true;
+	sortedParticlesNeedsRebuild=true;
+	springAdjacencyNeedsRebuild=true;
+	shapeMatchingRestPositionsNeedsUpdate=true;
+	localBoundsNeedsUpdate=true;
 	return this;
 }
 
@@ -174,6 +209,13 @@ QMesh *QMesh::SetPolygon(vector<QParticle *> polygonParticles)
 	collisionBehaviorNeedsUpdate=true;
 
 	polygonBisectorsNeedsUpdate=true;
+	polygonSegmentBVHNeedsUpdate=true;
+	polygonTopologyVersion+=1;
+	shapeMatchingRestPositionsNeedsUpdate=true;
+	if(ownerBody!=nullptr){
+		ownerBody->inertiaNeedsUpdate=true;
+		ownerBody->circumferenceNeedsUpdate=true;
+	}
 
     return this;
 }
@@ -190,6 +232,13 @@ QMesh *QMesh::AddParticleToPolygon(QParticle *particle, int position)
 	collisionBehaviorNeedsUpdate=true;
 
 	polygonBisectorsNeedsUpdate=true;
+	polygonSegmentBVHNeedsUpdate=true;
+	polygonTopologyVersion+=1;
+	shapeMatchingRestPositionsNeedsUpdate=true;
+	if(ownerBody!=nullptr){
+		ownerBody->inertiaNeedsUpdate=true;
+		ownerBody->circumferenceNeedsUpdate=true;
+	}
 
     return this;
 }
@@ -214,6 +263,13 @@ QMesh *QMesh::RemoveParticleFromPolygonAt(int index)
 	subConvexPolygonsNeedsUpdate=true;
 	collisionBehaviorNeedsUpdate=true;
 	polygonBisectorsNeedsUpdate=true;
+	polygonSegmentBVHNeedsUpdate=true;
+	polygonTopologyVersion+=1;
+	shapeMatchingRestPositionsNeedsUpdate=true;
+	if(ownerBody!=nullptr){
+		ownerBody->inertiaNeedsUpdate=true;
+		ownerBody->circumferenceNeedsUpdate=true;
+	}
     return this;
 }
 
@@ -223,6 +279,13 @@ QMesh *QMesh::RemovePolygon()
 	subConvexPolygons.clear();
 	collisionBehaviorNeedsUpdate=true;
 	polygonBisectorsNeedsUpdate=true;
+	polygonSegmentBVHNeedsUpdate=true;
+	polygonTopologyVersion+=1;
+	shapeMatchingRestPositionsNeedsUpdate=true;
+	if(ownerBody!=nullptr){
+		ownerBody->inertiaNeedsUpdate=true;
+		ownerBody->circumferenceNeedsUpdate=true;
+	}
     return this;
 }
 
@@ -236,18 +299,45 @@ QParticle *QMesh::GetParticleFromPolygon(int index)
     return polygon[index];
 }
 
+vector<QParticle *> &QMesh::GetParticlesSortedHorizontally()
+{
+	if(sortedParticlesNeedsRebuild){
+		sortedParticles=particles;
+		sort(sortedParticles.begin(),sortedParticles.end(),QParticle::SortParticlesHorizontal);
+		sortedParticlesNeedsRebuild=false;
+		return sortedParticles;
+	}
+	//The order of the previous call is nearly sorted, the insertion sort fixes it with a few swaps.
+	size_t particleCount=sortedParticles.size();
+	for(size_t i=1;i<particleCount;++i){
+		QParticle *particle=sortedParticles[i];
+		size_t n=i;
+		while(n>0 && QParticle::SortParticlesHorizontal(particle,sortedParticles[n-1]) ){
+			sortedParticles[n]=sortedParticles[n-1];
+			--n;
+		}
+		sortedParticles[n]=particle;
+	}
+	return sortedParticles;
+}
+
 void QMesh::UpdateSubConvexPolygons( bool majorUpdate)
 {
+	subConvexPolygonCachesNeedsUpdate=true;
+	subConvexPolygonLocalNormalsNeedsUpdate=true;
+	subConvexPolygonBVHNeedsUpdate=true;
+	polygonSegmentBVHNeedsUpdate=true;
 	
 	if(subConvexPolygons.size()==0){
-		DecompositePolygon(polygon,subConvexPolygons);	
+		DecompositePolygonWithCache();
 	}else{
 		if(majorUpdate==true){
-			subConvexPolygons.clear();
 			if(CheckIsPolygonConcave(polygon)==true	){
-				DecompositePolygon(polygon,subConvexPolygons);
+				DecompositePolygonWithCache();
 			}else{
-				subConvexPolygons.push_back( polygon );		
+				subConvexPolygons.clear();
+				subConvexPolygons.push_back( polygon );
+				subConvexPolygonsTopologyVersion=polygonTopologyVersion;
 			}
 		}else{
 			bool subPolygonsAreConcave=false;
@@ -258,8 +348,7 @@ void QMesh::UpdateSubConvexPolygons( bool majorUpdate)
 				}
 			}
 			if(subPolygonsAreConcave){
-				subConvexPolygons.clear();
-				DecompositePolygon(polygon,subConvexPolygons);	
+				DecompositePolygonWithCache();
 			}
 		}
 	}
@@ -267,18 +356,553 @@ void QMesh::UpdateSubConvexPolygons( bool majorUpdate)
 	
 }
 
+void QMesh::DecompositePolygonWithCache()
+{
+	static thread_local vector<char> signature;
+	static thread_local vector<QVector> polygonPoints;
+	static thread_local vector<vector<int>> subPolygonIndexes;
+	GetConvexitySignature(signature);
+
+	//Checking the previous decompositions of the same polygon
+	if(decompositionCacheTopologyVersion!=polygonTopologyVersion){
+		decompositionCache.clear();
+		decompositionCacheNextSlot=0;
+		decompositionCacheTopologyVersion=polygonTopologyVersion;
+	}
+	for(size_t i=0;i<decompositionCache.size();++i){
+		DecompositionCacheEntry &entry=decompositionCache[i];
+		if(entry.convexitySignature==signature && CheckAreSubPolygonIndexesConvex(entry.subPolygonIndexes) ){
+			SetSubConvexPolygonsFromIndexes(entry.subPolygonIndexes);
+			return;
+		}
+	}
+
+	polygonPoints.resize(polygon.size());
+	for(size_t i=0;i<polygon.size();++i){
+		polygonPoints[i]=polygon[i]->GetGlobalPosition();
+	}
+
+	//If the topology of the polygon isn't changed, the previous sub polygons are still valid until the worker thread finishes.
+	bool hasValidSubPolygons=subConvexPolygons.size()>0 && subConvexPolygonsTopologyVersion==polygonTopologyVersion;
+	if(asyncDecompositionEnabled && hasValidSubPolygons){
+		if(pendingDecomposition.valid() ){
+			decompositionRequestedWhilePending=true;
+			return;
+		}
+		pendingDecompositionSignature=signature;
+		pendingDecompositionTopologyVersion=polygonTopologyVersion;
+		pendingDecomposition=StartAsyncDecomposition(polygonPoints);
+		return;
+	}
+
+	//The pending result belongs to an older shape of the polygon.
+	if(pendingDecomposition.valid() ){
+		ApplyPendingDecomposition(true);
+	}
+	if(DecompositePolygonPoints(polygonPoints,subPolygonIndexes) ){
+		AddToDecompositionCache(signature,subPolygonIndexes);
+	}
+	SetSubConvexPolygonsFromIndexes(subPolygonIndexes);
+}
+
+void QMesh::GetConvexitySignature(vector<char> &signature)
+{
+	int polygonSize=polygon.size();
+	signature.resize(polygonSize);
+	for(int i=0;i<polygonSize;++i){
+		QVector pA=polygon[ (i-1+polygonSize)%polygonSize ]->GetGlobalPosition();
+		QVector pB=polygon[i]->GetGlobalPosition();
+		QVector pC=polygon[ (i+1)%polygonSize ]->GetGlobalPosition();
+		signature[i]=CheckIsReflex(pA,pB,pC) ? 1 : 0;
+	}
+}
+
+void QMesh::AddToDecompositionCache(const vector<char> &signature, const vector<vector<int>> &subPolygonIndexes)
+{
+	if(decompositionCacheTopologyVersion!=polygonTopologyVersion){
+		decompositionCache.clear();
+		decompositionCacheNextSlot=0;
+		decompositionCacheTopologyVersion=polygonTopologyVersion;
+	}
+	if(decompositionCache.size()<DECOMPOSITION_CACHE_SIZE){
+		decompositionCache.push_back(DecompositionCacheEntry() );
+		decompositionCacheNextSlot=decompositionCache.size()-1;
+	}
+	//The oldest entry is replaced, the assignments reuse its buffers.
+	DecompositionCacheEntry &entry=decompositionCache[decompositionCacheNextSlot];
+	entry.convexitySignature=signature;
+	entry.subPolygonIndexes=subPolygonIndexes;
+	decompositionCacheNextSlot=(decompositionCacheNextSlot+1)%DECOMPOSITION_CACHE_SIZE;
+}
+
+bool QMesh::CheckAreSubPolygonIndexesConvex(const vector<vector<int>> &subPolygonIndexes)
+{
+	int polygonSize=polygon.size();
+	for(size_t i=0;i<subPolygonIndexes.size();++i){
+		const vector<int> &indexes=subPolygonIndexes[i];
+		int pointCount=indexes.size();
+		//The corners of a convex polygon all turn to the same side.
+		bool hasLeftTurn=false;
+		bool hasRightTurn=false;
+		for(int n=0;n<pointCount;++n){
+			int ia=indexes[ (n-1+pointCount)%pointCount ];
+			int ib=indexes[n];
+			int ic=indexes[ (n+1)%pointCount ];
+			if(ia>=polygonSize || ib>=polygonSize || ic>=polygonSize)
+				return false;
+			QVector pA=polygon[ia]->GetGlobalPosition();
+			QVector pB=polygon[ib]->GetGlobalPosition();
+			QVector pC=polygon[ic]->GetGlobalPosition();
+			float turn=(pB-pA).Dot( (pC-pA).Perpendicular() );
+			//The tolerance is relative to the edge lengths, so nearly collinear corners don't have a side at any scale.
+			float toleranceSquared=(pB-pA).LengthSquared()*(pC-pA).LengthSquared()*CONVEXITY_TOLERANCE*CONVEXITY_TOLERANCE;
+			if(turn*turn<=toleranceSquared)
+				continue;
+			if(turn>0.0f)
+				hasLeftTurn=true;
+			else
+				hasRightTurn=true;
+		}
+		if(hasLeftTurn && hasRightTurn)
+			return false;
+	}
+	return true;
+}
+
+void QMesh::SetSubConvexPolygonsFromIndexes(const vector<vector<int>> &subPolygonIndexes)
+{
+	subConvexPolygons.resize(subPolygonIndexes.size());
+	for(size_t i=0;i<subPolygonIndexes.size();++i){
+		const vector<int> &indexes=subPolygonIndexes[i];
+		vector<QParticle*> &subPolygon=subConvexPolygons[i];
+		subPolygon.resize(indexes.size());
+		for(size_t n=0;n<indexes.size();++n){
+			subPolygon[n]=polygon[ indexes[n] ];
+		}
+	}
+	subConvexPolygonsTopologyVersion=polygonTopologyVersion;
+
+	subConvexPolygonCachesNeedsUpdate=true;
+	subConvexPolygonLocalNormalsNeedsUpdate=true;
+	subConvexPolygonBVHNeedsUpdate=true;
+}
+
+void QMesh::ApplyPendingDecomposition(bool waitForResult)
+{
+	if(waitForResult==false && pendingDecomposition.wait_for(chrono::seconds(0))!=future_status::ready )
+		return;
+	vector<vector<int>> subPolygonIndexes=pendingDecomposition.get();
+	//The result is discarded if the topology of the polygon has changed in the meantime.
+	if(subPolygonIndexes.size()>0 && pendingDecompositionTopologyVersion==polygonTopologyVersion){
+		AddToDecompositionCache(pendingDecompositionSignature,subPolygonIndexes);
+		SetSubConvexPolygonsFromIndexes(subPolygonIndexes);
+	}
+	if(decompositionRequestedWhilePending){
+		decompositionRequestedWhilePending=false;
+		subConvexPolygonsNeedsUpdate=true;
+	}
+}
+
+void QMesh::UpdateSubConvexPolygonCaches()
+{
+	int polygonCount=GetSubConvexPolygonCount();
+	if(subConvexPolygonCachesNeedsUpdate==false)
+		return;
+
+	subConvexPolygonCaches.resize(polygonCount);
+
+	//The local shapes of rigid bodies don't change, so their normals are only rotated instead of computing from the global positions.
+	bool isRigid=ownerBody!=nullptr && ownerBody->GetSimulationModel()==QBody::SimulationModels::RIGID_BODY;
+	QVector rotVecUnit=isRigid ? QVector::AngleToUnitVector(globalRotation) : QVector::Zero();
+	bool updateLocalNormals=isRigid && subConvexPolygonLocalNormalsNeedsUpdate;
+
+	for(int i=0;i<polygonCount;++i){
+		UpdateConvexPolygonCache(subConvexPolygons[i],subConvexPolygonCaches[i],isRigid,rotVecUnit,updateLocalNormals);
+	}
+
+	if(updateLocalNormals){
+		UpdateConvexHull();
+	}else if(isRigid==false){
+		convexHull.clear();
+	}
+	if(convexHull.size()>0){
+		UpdateConvexPolygonCache(convexHull,convexHullCache,isRigid,rotVecUnit,updateLocalNormals);
+	}
+
+	if(subConvexPolygonBVHNeedsUpdate){
+		BuildSubConvexPolygonBVH();
+		subConvexPolygonBVHNeedsUpdate=false;
+	}
+	//Refitting the bounding volume hierarchy
+	for(int i=subConvexPolygonBVH.size()-1;i>=0;--i){
+		BVHNode &node=subConvexPolygonBVH[i];
+		if(node.leafIndex!=-1){
+			node.aabb=subConvexPolygonCaches[node.leafIndex].aabb;
+		}else{
+			node.aabb=QAABB::Combine(subConvexPolygonBVH[node.left].aabb,subConvexPolygonBVH[node.right].aabb);
+		}
+	}
+
+	if(isRigid)
+		subConvexPolygonLocalNormalsNeedsUpdate=false;
+	subConvexPolygonCachesNeedsUpdate=false;
+}
+
+void QMesh::UpdateConvexPolygonCache(vector<QParticle *> &polygonParticles, QCollision::ConvexPolygonCache &cache, bool isRigid, QVector rotVecUnit, bool updateLocalNormals)
+{
+	int pointCount=polygonParticles.size();
+	cache.xs.resize(pointCount);
+	cache.ys.resize(pointCount);
+	cache.normals.resize(pointCount);
+
+	QVector minPos(QWorld::MAX_WORLD_SIZE,QWorld::MAX_WORLD_SIZE);
+	QVector maxPos(-QWorld::MAX_WORLD_SIZE,-QWorld::MAX_WORLD_SIZE);
+	for(int n=0;n<pointCount;++n){
+		QVector pos=polygonParticles[n]->GetGlobalPosition();
+		cache.xs[n]=pos.x;
+		cache.ys[n]=pos.y;
+		minPos.x=min(minPos.x,pos.x);
+		minPos.y=min(minPos.y,pos.y);
+		maxPos.x=max(maxPos.x,pos.x);
+		maxPos.y=max(maxPos.y,pos.y);
+	}
+	cache.aabb.SetMinMax(minPos,maxPos);
+
+	if(isRigid){
+		if(updateLocalNormals){
+			cache.localNormals.resize(pointCount);
+			for(int n=0;n<pointCount;++n){
+				QVector edge=polygonParticles[(n+1)%pointCount]->GetPosition()-polygonParticles[n]->GetPosition();
+				cache.localNormals[n]=edge.Normalized().Perpendicular();
+			}
+			//Boxes and other centrally symmetric polygons need only the half of their normals as separating axes.
+			cache.axisCount=pointCount;
+			if(pointCount%2==0){
+				int halfCount=pointCount/2;
+				bool isSymmetric=true;
+				for(int n=0;n<halfCount;++n){
+					if( (cache.localNormals[n]+cache.localNormals[n+halfCount]).LengthSquared()>0.000001f ){
+						isSymmetric=false;
+						break;
+					}
+				}
+				if(isSymmetric)
+					cache.axisCount=halfCount;
+			}
+		}
+		for(int n=0;n<pointCount;++n){
+			QVector ln=cache.localNormals[n];
+			cache.normals[n]=QVector(ln.x*rotVecUnit.x-ln.y*rotVecUnit.y, ln.y*rotVecUnit.x+ln.x*rotVecUnit.y);
+		}
+	}else{
+		for(int n=0;n<pointCount;++n){
+			int nn=(n+1)%pointCount;
+			QVector edge(cache.xs[nn]-cache.xs[n],cache.ys[nn]-cache.ys[n]);
+			cache.normals[n]=edge.Normalized().Perpendicular();
+		}
+		cache.axisCount=pointCount;
+	}
+}
+
+void QMesh::BuildSubConvexPolygonBVH()
+{
+	subConvexPolygonBVH.clear();
+	int polygonCount=subConvexPolygonCaches.size();
+	//A single polygon doesn't need a hierarchy.
+	if(polygonCount<2)
+		return;
+	vector<int> polygonIndexes(polygonCount);
+	for(int i=0;i<polygonCount;++i){
+		polygonIndexes[i]=i;
+	}
+	subConvexPolygonBVH.reserve(polygonCount*2-1);
+	BuildSubConvexPolygonBVHNode(polygonIndexes,0,polygonCount);
+}
+
+int QMesh::BuildSubConvexPolygonBVHNode(vector<int> &polygonIndexes, int begin, int end)
+{
+	int nodeIndex=subConvexPolygonBVH.size();
+	subConvexPolygonBVH.push_back(BVHNode());
+	if(end-begin==1){
+		subConvexPolygonBVH[nodeIndex].leafIndex=polygonIndexes[begin];
+		return nodeIndex;
+	}
+
+	//Splitting the polygons from the median of their centers along the longest axis of the node
+	QAABB nodeAABB=subConvexPolygonCaches[polygonIndexes[begin]].aabb;
+	for(int i=begin+1;i<end;++i){
+		nodeAABB=QAABB::Combine(nodeAABB,subConvexPolygonCaches[polygonIndexes[i]].aabb);
+	}
+	bool splitX=nodeAABB.GetSize().x>nodeAABB.GetSize().y;
+	int middle=(begin+end)/2;
+	nth_element(polygonIndexes.begin()+begin,polygonIndexes.begin()+middle,polygonIndexes.begin()+end,[this,splitX](int a,int b){
+		QVector centerA=subConvexPolygonCaches[a].aabb.GetCenterPosition();
+		QVector centerB=subConvexPolygonCaches[b].aabb.GetCenterPosition();
+		return splitX ? centerA.x<centerB.x : centerA.y<centerB.y;
+	});
+
+	int left=BuildSubConvexPolygonBVHNode(polygonIndexes,begin,middle);
+	int right=BuildSubConvexPolygonBVHNode(polygonIndexes,middle,end);
+	subConvexPolygonBVH[nodeIndex].left=left;
+	subConvexPolygonBVH[nodeIndex].right=right;
+	return nodeIndex;
+}
+
+void QMesh::UpdateConvexHull()
+{
+	convexHull.clear();
+	//Only the concave polygons of rigid meshes need a hull. Their local shapes don't change, so the hull is computed once from the local positions.
+	if(subConvexPolygons.size()<2)
+		return;
+
+	//Andrew's monotone chain algorithm
+	vector<QParticle*> points=polygon;
+	sort(points.begin(),points.end(),[](QParticle *a,QParticle *b){
+		QVector posA=a->GetPosition();
+		QVector posB=b->GetPosition();
+		return posA.x<posB.x || (posA.x==posB.x && posA.y<posB.y);
+	});
+	int pointCount=points.size();
+	if(pointCount<3)
+		return;
+	auto cross=[](QParticle *o,QParticle *a,QParticle *b){
+		QVector oa=a->GetPosition()-o->GetPosition();
+		QVector ob=b->GetPosition()-o->GetPosition();
+		return oa.x*ob.y-oa.y*ob.x;
+	};
+	vector<QParticle*> hull(pointCount*2);
+	int k=0;
+	for(int i=0;i<pointCount;++i){
+		while(k>=2 && cross(hull[k-2],hull[k-1],points[i])<=0 )
+			k--;
+		hull[k++]=points[i];
+	}
+	for(int i=pointCount-2,t=k+1;i>=0;--i){
+		while(k>=t && cross(hull[k-2],hull[k-1],points[i])<=0 )
+			k--;
+		hull[k++]=points[i];
+	}
+	hull.resize(k-1);
+	convexHull=hull;
+}
+
+void QMesh::UpdatePolygonSegmentBVH()
+{
+	if(polygonSegmentBVHNeedsUpdate==false)
+		return;
+	int segmentCount=polygon.size();
+	if(segmentCount==0){
+		polygonSegmentBVH.clear();
+		polygonSegmentBVHNeedsUpdate=false;
+		return;
+	}
+	//The segments are already in the order of the polyline, the topology only depends on the segment count.
+	if((int)polygonSegmentBVH.size()!=segmentCount*2-1){
+		polygonSegmentBVH.clear();
+		polygonSegmentBVH.reserve(segmentCount*2-1);
+		BuildPolygonSegmentBVHNode(0,segmentCount);
+	}
+
+	//Refitting. The bounds are fattened with the radii of the particles, since the collision tests move the segments along their normals by the radii.
+	for(int i=polygonSegmentBVH.size()-1;i>=0;--i){
+		BVHNode &node=polygonSegmentBVH[i];
+		if(node.leafIndex!=-1){
+			QParticle *pA=polygon[node.leafIndex];
+			QParticle *pB=polygon[(node.leafIndex+1)%segmentCount];
+			QVector posA=pA->GetGlobalPosition();
+			QVector posB=pB->GetGlobalPosition();
+			float radius=max(pA->GetRadius(),pB->GetRadius() )+0.01f;
+			QVector radiusVec(radius,radius);
+			node.aabb.SetMinMax(QVector(min(posA.x,posB.x),min(posA.y,posB.y))-radiusVec, QVector(max(posA.x,posB.x),max(posA.y,posB.y))+radiusVec );
+		}else{
+			node.aabb=QAABB::Combine(polygonSegmentBVH[node.left].aabb,polygonSegmentBVH[node.right].aabb);
+		}
+	}
+	polygonSegmentBVHNeedsUpdate=false;
+}
+
+int QMesh::BuildPolygonSegmentBVHNode(int begin, int end)
+{
+	int nodeIndex=polygonSegmentBVH.size();
+	polygonSegmentBVH.push_back(BVHNode());
+	if(end-begin==1){
+		polygonSegmentBVH[nodeIndex].leafIndex=begin;
+		return nodeIndex;
+	}
+	int middle=(begin+end)/2;
+	int left=BuildPolygonSegmentBVHNode(begin,middle);
+	int right=BuildPolygonSegmentBVHNode(middle,end);
+	polygonSegmentBVH[nodeIndex].left=left;
+	polygonSegmentBVH[nodeIndex].right=right;
+	return nodeIndex;
+}
+
+void QMesh::GetPolygonSegmentsInAABB(const QAABB &aabb, vector<int> &segmentIndexes)
+{
+	UpdatePolygonSegmentBVH();
+	if(polygonSegmentBVH.size()==0)
+		return;
+	//The left children are visited first, so the segments are found in the ascending order.
+	int stack[64];
+	int stackSize=0;
+	stack[stackSize++]=0;
+	while(stackSize>0){
+		BVHNode &node=polygonSegmentBVH[stack[--stackSize]];
+		if(node.aabb.isCollidingWith(aabb)==false)
+			continue;
+		if(node.leafIndex!=-1){
+			segmentIndexes.push_back(node.leafIndex);
+		}else{
+			stack[stackSize++]=node.right;
+			stack[stackSize++]=node.left;
+		}
+	}
+}
+
+int QMesh::FindNearestPolygonParticle(QVector point, QParticle *exceptParticle)
+{
+	UpdatePolygonSegmentBVH();
+	int segmentCount=polygon.size();
+	int res=0;
+	float minDistanceSq=QWorld::MAX_WORLD_SIZE*QWorld::MAX_WORLD_SIZE;
+	if(segmentCount==0)
+		return res;
+	//The nodes farther than the nearest particle found are skipped.
+	int stack[64];
+	int stackSize=0;
+	stack[stackSize++]=0;
+	while(stackSize>0){
+		BVHNode &node=polygonSegmentBVH[stack[--stackSize]];
+		QVector nodeMin=node.aabb.GetMin();
+		QVector nodeMax=node.aabb.GetMax();
+		float dx=max(max(nodeMin.x-point.x,point.x-nodeMax.x),0.0f);
+		float dy=max(max(nodeMin.y-point.y,point.y-nodeMax.y),0.0f);
+		if(dx*dx+dy*dy>minDistanceSq)
+			continue;
+		if(node.leafIndex!=-1){
+			for(int n=0;n<2;++n){
+				int i=(node.leafIndex+n)%segmentCount;
+				QParticle *p=polygon[i];
+				if(p==exceptParticle)
+					continue;
+				float distanceSq=(point-p->GetGlobalPosition()).LengthSquared();
+				if(distanceSq<minDistanceSq || (distanceSq==minDistanceSq && i<res) ){
+					minDistanceSq=distanceSq;
+					res=i;
+				}
+			}
+		}else{
+			stack[stackSize++]=node.right;
+			stack[stackSize++]=node.left;
+		}
+	}
+	return res;
+}
+
 void QMesh::UpdatePolygonBisectors()
 {
 	if(polygonBisectorsNeedsUpdate==true){
-		polygonBisectors=QMesh::GetBisectors(polygon);
+		//Long polygons find the bisector hits with the segment BVH.
+		if(polygon.size()>=16){
+			UpdatePolygonBisectorsWithSegmentBVH();
+		}else{
+			QMesh::GetBisectors(polygon,polygonBisectors);
+		}
 		polygonBisectorsNeedsUpdate=false;
 	}
 	
 }
 
-vector<QVector> QMesh::GetBisectors(vector<QParticle *> polygonParticles)
+void QMesh::UpdatePolygonBisectorsWithSegmentBVH()
 {
-	vector<QVector> res;
+	UpdatePolygonSegmentBVH();
+	size_t polygonSize=polygon.size();
+	polygonBisectors.resize(polygonSize);
+	polygonBisectorHitSegments.resize(polygonSize,-1);
+
+	int stack[64];
+	for (size_t i=0;i<polygonSize;i++ ){
+		QParticle *pp=polygon[ (i-1+polygonSize )%polygonSize ]; //previous particle
+		QParticle *p=polygon[i]; // particle
+		QParticle *np=polygon[ (i+1 )%polygonSize ]; //next particle
+
+		QVector bisectorUnit=QVector::GeteBisectorUnitVector(pp->GetGlobalPosition(), p->GetGlobalPosition(), np->GetGlobalPosition(),true);
+		QVector rayStart=p->GetGlobalPosition();
+		QVector rayEnd=rayStart+bisectorUnit*QWorld::MAX_WORLD_SIZE;
+
+		float bisectorLen=1.0f;
+		float bestDistance=QWorld::MAX_WORLD_SIZE;
+		int bestSegment=-1;
+
+		auto testSegment=[&](int n){
+			QParticle *s1=polygon[n];
+			QParticle *s2=polygon[ (n+1)%polygonSize ];
+			if(s1==pp || s1==np || s1==p){
+				return;
+			}
+			QVector bisectorIntersection=QCollision::LineIntersectionLine(rayStart,rayEnd,s1->GetGlobalPosition(),s2->GetGlobalPosition()  );
+			if(bisectorIntersection.isNaN()==false ){
+				float len=(rayStart-bisectorIntersection).Length();
+				if(len<bestDistance){
+					bisectorLen=len;
+					bestDistance=len;
+					bestSegment=n;
+				}
+			}
+		};
+
+		//The hit segment of the previous update is usually still the nearest one. Testing it first makes the BVH traversal skip most of the nodes.
+		int previousSegment=polygonBisectorHitSegments[i];
+		if(previousSegment>=0 && previousSegment<(int)polygonSize){
+			testSegment(previousSegment);
+		}
+
+		int stackSize=0;
+		stack[stackSize++]=0;
+		while(stackSize>0){
+			BVHNode &node=polygonSegmentBVH[stack[--stackSize]];
+			//The distance of the ray to the node bounds (slab test)
+			QVector nodeMin=node.aabb.GetMin();
+			QVector nodeMax=node.aabb.GetMax();
+			float entryDistance=0.0f;
+			float exitDistance=QWorld::MAX_WORLD_SIZE;
+			bool isMissed=false;
+			for(int axis=0;axis<2;++axis){
+				float origin=axis==0 ? rayStart.x : rayStart.y;
+				float direction=axis==0 ? bisectorUnit.x : bisectorUnit.y;
+				float slabMin=axis==0 ? nodeMin.x : nodeMin.y;
+				float slabMax=axis==0 ? nodeMax.x : nodeMax.y;
+				if(direction==0.0f){
+					if(origin<slabMin || origin>slabMax){
+						isMissed=true;
+					}
+					continue;
+				}
+				float t1=(slabMin-origin)/direction;
+				float t2=(slabMax-origin)/direction;
+				entryDistance=max(entryDistance,min(t1,t2) );
+				exitDistance=min(exitDistance,max(t1,t2) );
+			}
+			if(isMissed || entryDistance>exitDistance || entryDistance>bestDistance)
+				continue;
+
+			if(node.leafIndex!=-1){
+				if(node.leafIndex!=previousSegment)
+					testSegment(node.leafIndex);
+			}else{
+				stack[stackSize++]=node.right;
+				stack[stackSize++]=node.left;
+			}
+		}
+
+		polygonBisectors[i]=bisectorUnit*bisectorLen;
+		polygonBisectorHitSegments[i]=bestSegment;
+	}
+}
+
+void QMesh::GetBisectors(const vector<QParticle *> &polygonParticles,vector<QVector> &bisectors)
+{
+	bisectors.resize(polygonParticles.size() );
 	for (size_t i=0;i<polygonParticles.size();i++ ){
 		QParticle *pp=polygonParticles[ (i-1+polygonParticles.size() )%polygonParticles.size() ]; //previous particle
 		QParticle *p=polygonParticles[i]; // particle
@@ -295,7 +919,7 @@ vector<QVector> QMesh::GetBisectors(vector<QParticle *> polygonParticles)
 				continue;
 			}
 			QVector bisectorIntersection=QCollision::LineIntersectionLine(p->GetGlobalPosition(),p->GetGlobalPosition()+bisectorUnit*QWorld::MAX_WORLD_SIZE,s1->GetGlobalPosition(),s2->GetGlobalPosition()  );
-			if(bisectorIntersection!=QVector::NaN() ){
+			if(bisectorIntersection.isNaN()==false ){
 				float len=(p->GetGlobalPosition()-bisectorIntersection).Length();
 				if(len<bestDistance){
 					bisectorLen=len;
@@ -304,11 +928,45 @@ vector<QVector> QMesh::GetBisectors(vector<QParticle *> polygonParticles)
 			}
 		}
 
-		res.push_back(bisectorUnit*bisectorLen);
+		bisectors[i]=bisectorUnit*bisectorLen;
+
 
+	}
+}
+
+bool QMesh::CheckIsPolygonSelfIntersected(QVector &intersection)
+{
+	int polygonSize=polygon.size();
+	//Long polygons only test the segments overlapping in the segment BVH.
+	bool useSegmentBVH=polygonSize>=16;
+	static thread_local vector<int> candidateSegments;
+	for(int i=0;i<polygonSize;++i ){
+		int ni=(i+1)%polygonSize;
+		int pi=(i-1+polygonSize)%polygonSize;
+		QVector d1A=polygon[i]->GetGlobalPosition();
+		QVector d1B=polygon[ni]->GetGlobalPosition();
+		int candidateCount=polygonSize;
+		if(useSegmentBVH){
+			candidateSegments.clear();
+			GetPolygonSegmentsInAABB(QAABB(QVector(min(d1A.x,d1B.x),min(d1A.y,d1B.y)),QVector(max(d1A.x,d1B.x),max(d1A.y,d1B.y)) ),candidateSegments);
+			candidateCount=candidateSegments.size();
+		}
+		for(int c=0;c<candidateCount;++c ){
+			int n=useSegmentBVH ? candidateSegments[c] : c;
+			//Each pair is tested once, and the neighbor segments always share a particle.
+			if(n<=i || n==ni || n==pi )continue;
+			QVector d2A=polygon[n]->GetGlobalPosition();
+			QVector d2B=polygon[ (n+1)%polygonSize ]->GetGlobalPosition();
+
+			intersection=QCollision::LineIntersectionLine(d1A,d1B,d2A,d2B );
+			
+			if(intersection.isNaN()==false ){
+				return true;
+			}
+		}
 
 	}
-    return res;
+	return false;
 }
 
 void QMesh::ApplyAngleConstraintsToPolygon()
@@ -318,27 +976,19 @@ void QMesh::ApplyAngleConstraintsToPolygon()
 	}
 
 	//Intersection Test
-	bool polygonIntersection=false;
-	for(int i=0;i<polygon.size();++i ){
-		int ni=(i+1)%polygon.size();
-		QParticle* d1A=polygon[i];
-		QParticle* d1B=polygon[ (i+1)%polygon.size() ];
-		for(int n=i+1;n<polygon.size();++n ){
-			if(n==i || n==ni || n==(i-1+polygon.size())%polygon.size() )continue;
-			QParticle* d2A=polygon[n];
-			QParticle* d2B=polygon[ (n+1)%polygon.size() ];
-
-			QVector intersection=QCollision::LineIntersectionLine(d1A->GetGlobalPosition(),d1B->GetGlobalPosition(),d2A->GetGlobalPosition(),d2B->GetGlobalPosition() );
-			
-			if(intersection.isNaN()==false ){
-				d1A->GetOwnerMesh()->GetOwnerBody()->GetWorld()->GetGizmos()->push_back(new QGizmoCircle(intersection,5.0) );
-				polygonIntersection=true;
-				break;
-			}
+	//The test can be run only every k steps, the last result is used between them.
+	polygonSelfIntersectionTestCounter+=1;
+	if(polygonSelfIntersectionTestCounter>=polygonSelfIntersectionTestInterval){
+		polygonSelfIntersectionTestCounter=0;
+		QVector intersection;
+		isPolygonSelfIntersected=CheckIsPolygonSelfIntersected(intersection);
+		if(isPolygonSelfIntersected){
+			QWorld *world=ownerBody!=nullptr ? ownerBody->GetWorld() : nullptr;
+			if(world!=nullptr && world->GetDebugGizmosEnabled() )
+				world->GetGizmos()->AddCircle(intersection,5.0);
 		}
-
 	}
-	isPolygonSelfIntersected=polygonIntersection;
+	bool polygonIntersection=isPolygonSelfIntersected;
 	if(polygonIntersection==true){
 		//cout<<"there is line intersection in polygon"<<endl;
 		pair<QVector,float> averagePosRot=QMesh::GetAveragePositionAndRotation(polygon);
@@ -463,205 +1113,362 @@ bool QMesh::CheckIsReflex(int indexA, int indexB, int indexC, vector<QParticle *
     return CheckIsReflex( polygonParticles[indexA]->GetGlobalPosition(),polygonParticles[indexB]->GetGlobalPosition(),polygonParticles[indexC]->GetGlobalPosition() );
 }
 
-void QMesh::TriangulatePolygon(vector<QParticle *> &polygonParticles, vector<vector<int>> &triangles)
+void QMesh::DecompositePolygon(vector<QParticle *> &polygonParticles, vector<vector<QParticle *>> &polygons)
 {
-	vector<int> indexList;
-	for (int i=0;i<polygonParticles.size();i++ ){
-		indexList.push_back(i);
+	vector<QVector> polygon;
+	for (int i=0;i<polygonParticles.size();++i ){
+		polygon.push_back(polygonParticles[i]->GetGlobalPosition() );
 	}
 
-	int maxIterationCount=indexList.size()*3;
-	int iterationCount=0;
+	vector<vector<int>> subPolygonIndexes;
+	DecompositePolygonPoints(polygon,subPolygonIndexes);
 
-	
-	while (indexList.size()>3 ){
-		iterationCount+=1;
-		if (iterationCount>maxIterationCount){
-			break;
+	for (auto indexes:subPolygonIndexes){
+		vector<QParticle*> qpoly;
+		for(size_t i=0;i<indexes.size();++i){
+			qpoly.push_back(polygonParticles[indexes[i]]);
 		}
-		
-		
-		for (int i=0;i<indexList.size();i++ ){
-			int pi=indexList[ (i-1+indexList.size() )%indexList.size() ]; //previous index
-			int ci=indexList[i]; //current index
-			int ni=indexList[ (i+1)%indexList.size() ]; // next index
-
-			QVector pp=polygonParticles[pi]->GetPosition(); // previous particle position
-			QVector cp=polygonParticles[ci]->GetPosition(); // current particle position
-			QVector np=polygonParticles[ni]->GetPosition(); // next particle position
-			
+		polygons.push_back(qpoly);
+	}
+}
 
-			//Checking whether the vertice is ear  
-			if ( CheckIsReflex(pp,cp,np) )
-				continue;
+vector<vector<int>> QMesh::DecompositeCopiedPolygonPoints(vector<QVector> polygonPoints)
+{
+	//It only works on the copied points, so it's safe to call from a worker thread.
+	vector<vector<int>> subPolygonIndexes;
+	DecompositePolygonPoints(polygonPoints,subPolygonIndexes);
+	return subPolygonIndexes;
+}
 
-			QVector cp2npPerp=(np-cp).Perpendicular();
-			QVector np2ppPerp=(pp-np).Perpendicular();
-			QVector pp2cpPerp=(cp-pp).Perpendicular();
-			
-			// Checking other vertices are in the triangle 
-			bool isThereAVertice=false;
-			for (int n=0;n<indexList.size();n++ ){
-				int ti=indexList[n]; // test index
-				if (ti==pi || ti==ci || ti==ni)
-					continue;
-				QVector tp=polygonParticles[ti]->GetPosition(); // test particle position
+//The asynchronous decompositions of all meshes are run in order on a single worker thread. The thread is started with the first request.
+struct QDecompositionWorker{
+	mutex tasksMutex;
+	condition_variable tasksCondition;
+	deque<packaged_task<vector<vector<int>>()>> tasks;
+	thread worker;
+	bool stopping=false;
+
+	void Run(){
+		while(true){
+			packaged_task<vector<vector<int>>()> task;
+			{
+				unique_lock<mutex> lock(tasksMutex);
+				tasksCondition.wait(lock,[this](){ return stopping || tasks.empty()==false; });
+				if(tasks.empty())
+					return;
+				task=move(tasks.front());
+				tasks.pop_front();
+			}
+			task();
+		}
+	}
 
-				float d1=(tp-cp).Dot( cp2npPerp );
-				float d2=(tp-np).Dot( np2ppPerp );
-				float d3=(tp-pp).Dot( pp2cpPerp );
+	~QDecompositionWorker(){
+		{
+			lock_guard<mutex> lock(tasksMutex);
+			stopping=true;
+		}
+		tasksCondition.notify_one();
+		if(worker.joinable())
+			worker.join();
+	}
+};
 
-				if ( (d1>0 && d2>0 && d3>0 ) || (d1<0 && d2<0 && d3<0) ){
-					isThereAVertice=true;
-					break;
-				}
+static QDecompositionWorker &GetDecompositionWorker(){
+	static QDecompositionWorker decompositionWorker;
+	return decompositionWorker;
+}
 
-			}
+future<vector<vector<int>>> QMesh::StartAsyncDecomposition(vector<QVector> polygonPoints)
+{
+	packaged_task<vector<vector<int>>()> task(bind(&QMesh::DecompositeCopiedPolygonPoints,move(polygonPoints) ) );
+	future<vector<vector<int>>> result=task.get_future();
+	QDecompositionWorker &decompositionWorker=GetDecompositionWorker();
+	{
+		lock_guard<mutex> lock(decompositionWorker.tasksMutex);
+		if(decompositionWorker.worker.joinable()==false)
+			decompositionWorker.worker=thread(&QDecompositionWorker::Run,&decompositionWorker);
+		decompositionWorker.tasks.push_back(move(task));
+	}
+	decompositionWorker.tasksCondition.notify_one();
+	return result;
+}
 
-			//Adding a new triangle and removing ear from the polygon
-			if (isThereAVertice==false){
-				vector<int> triangle={pi,ci,ni};
-				triangles.push_back ( triangle);
-				indexList.erase(indexList.begin()+i);
-				break;
-			}
+bool QMesh::DecompositePolygonPoints(const vector<QVector> &polygonPoints, vector<vector<int>> &subPolygonIndexes)
+{
+	static thread_local DecompositionArena arena;
+	int pointCount=polygonPoints.size();
+	subPolygonIndexes.clear();
+	if(pointCount<3){
+		cout<<"QuarkPhysics Error: Convex decomposing failed!"<<endl;
+		return false;
+	}
 
-		}
+	//The arena works on the counter clockwise order of the points.
+	double area=0.0;
+	for(int i=0;i<pointCount;++i){
+		const QVector &pA=polygonPoints[i];
+		const QVector &pB=polygonPoints[ (i+1)%pointCount ];
+		area+=(double)pA.x*pB.y-(double)pA.y*pB.x;
+	}
+	arena.xs.resize(pointCount);
+	arena.ys.resize(pointCount);
+	arena.polygonIndexes.resize(pointCount);
+	for(int i=0;i<pointCount;++i){
+		int index=area<0.0 ? pointCount-1-i : i;
+		arena.xs[i]=polygonPoints[index].x;
+		arena.ys[i]=polygonPoints[index].y;
+		arena.polygonIndexes[i]=index;
 	}
 
-	//Adding the final three points as a triangle to the triangles
-	vector<int> lastTriangle;
-	for (int i=0;i<indexList.size();i++ ){
-		lastTriangle.push_back(indexList[i] );
+	//If there is no reflex vertex, the polygon is already convex.
+	bool hasReflex=false;
+	for(int i=0;i<pointCount;++i){
+		int pi=(i-1+pointCount)%pointCount;
+		int ni=(i+1)%pointCount;
+		double cross=(arena.ys[ni]-arena.ys[pi])*(arena.xs[i]-arena.xs[pi])-(arena.xs[ni]-arena.xs[pi])*(arena.ys[i]-arena.ys[pi]);
+		if(cross<0.0){
+			hasReflex=true;
+			break;
+		}
+	}
+	if(hasReflex==false){
+		subPolygonIndexes.resize(1);
+		subPolygonIndexes[0].assign(arena.polygonIndexes.begin(),arena.polygonIndexes.end() );
+		return true;
 	}
-	triangles.push_back(lastTriangle);
 
+	if(TriangulateDecompositionArena(arena)==false){
+		cout<<"QuarkPhysics Error: Convex decomposing failed!"<<endl;
+		return false;
+	}
+	MergeDecompositionArenaTriangles(arena);
 
+	int subPolygonCount=0;
+	for(int i=0;i<arena.polygonCount;++i){
+		if(arena.isPolygonAlive[i])
+			subPolygonCount+=1;
+	}
+	subPolygonIndexes.resize(subPolygonCount);
+	int subPolygonIndex=0;
+	for(int i=0;i<arena.polygonCount;++i){
+		if(arena.isPolygonAlive[i]==false)
+			continue;
+		vector<int> &vertices=arena.polygons[i];
+		vector<int> &indexes=subPolygonIndexes[subPolygonIndex++];
+		indexes.resize(vertices.size());
+		for(size_t n=0;n<vertices.size();++n){
+			indexes[n]=arena.polygonIndexes[ vertices[n] ];
+		}
+	}
+	return true;
 }
 
-void QMesh::DecompositePolygon2(vector<QParticle *> &polygonParticles, vector<vector<QParticle *>> &polygons)
+void QMesh::UpdateDecompositionArenaVertex(DecompositionArena &arena, int vertex)
 {
-	
-	vector<vector<int>> subPolygons;
-	TriangulatePolygon(polygonParticles,subPolygons);
+	int pi=arena.previous[vertex];
+	int ni=arena.next[vertex];
+	double px=arena.xs[pi], py=arena.ys[pi];
+	double cx=arena.xs[vertex], cy=arena.ys[vertex];
+	double nx=arena.xs[ni], ny=arena.ys[ni];
+
+	arena.isConvex[vertex]=(ny-py)*(cx-px)-(nx-px)*(cy-py)>0.0;
+
+	//The cosine of the corner, the sharpest ears are clipped first.
+	double ax=px-cx, ay=py-cy;
+	double bx=nx-cx, by=ny-cy;
+	double aLength=sqrt(ax*ax+ay*ay);
+	double bLength=sqrt(bx*bx+by*by);
+	if(aLength!=0.0){
+		ax/=aLength;
+		ay/=aLength;
+	}
+	if(bLength!=0.0){
+		bx/=bLength;
+		by/=bLength;
+	}
+	arena.angles[vertex]=ax*bx+ay*by;
 
-	
-	
-	int ia=0;
-
-	//Per all subPolygons
-	while (ia!=subPolygons.size()){
-		// cout<<"started subpolygons loop ia is:"<<ia <<endl;
-		auto polyA=subPolygons[ia];
-		bool isDiagonal=false;
-		//Check diagonals
-		for (size_t na=0;na<polyA.size();na++ ){
-			int pA1=polyA[na ];
-			int pA2=polyA[ (na+1)%polyA.size() ];
-
-			for (size_t ib=0;ib<subPolygons.size();ib++ ){
-				if (ia==ib)
-					continue;
-				// cout<<"started subpolygons loop ib is:"<<ib <<endl;
-				auto polyB=subPolygons[ib];
-				for (size_t nb=0;nb<polyB.size();nb++ ){
-					int pB1=polyB[nb];
-					int pB2=polyB[ (nb+1)%polyB.size() ];
-					if (pB2==pA1 && pB1==pA2){
-						//Finded a diagonal polygon. checking reflex... 
-						if (CheckIsReflex( polyA[ (na-1+polyA.size() )%polyA.size() ], pA1, polyB[(nb+2) % polyB.size() ],polygonParticles ) )
-							continue;
-						if ( CheckIsReflex(polyB[ (nb-1+polyB.size())%polyB.size() ], pA2, polyA[ (na+2)%polyA.size() ],polygonParticles )  )
-							continue;
-						//There is no exist reflexes. So the new polygon can be convex.
-						int pIndex=(nb+1)%polyB.size();
-						int pos=na+1;
-						//Adding points to first polygon
-						// cout<<"adding next polygon to prev polygon"<<endl;
-						while (pIndex!=(nb-1+polyB.size() )%polyB.size() ){
-							pIndex=(pIndex+1)%polyB.size();
-							polyA.insert(polyA.begin()+pos,polyB[pIndex]);
-							pos+=1;
-						}
-						subPolygons[ia]=polyA;
-						// cout<<"erased polygon"<<endl;
-						subPolygons.erase(subPolygons.begin()+ib );
-						// cout<<"erased polygon finished"<<endl;
-						isDiagonal=true;
-						break;
-					}
-				}
-				if (isDiagonal){
-					// cout<<"exiting for polyB  loop"<<endl;
-					break;
-				}
-			}
-			if (isDiagonal){
-				// cout<<"exiting for polyA loop"<<endl;
-				break;	
-			}
-		}
-		if (isDiagonal){
-			// cout<<"continue subpolygons loop ia is:"<<ia <<endl;
+	if(arena.isConvex[vertex]==false){
+		arena.isEar[vertex]=false;
+		return;
+	}
+	//Only the non convex vertices of the remaining polygon can be inside an ear.
+	arena.isEar[vertex]=true;
+	for(int i=arena.next[ni];i!=pi;i=arena.next[i]){
+		if(arena.isConvex[i])
+			continue;
+		double tx=arena.xs[i], ty=arena.ys[i];
+		if( (tx==cx && ty==cy) || (tx==px && ty==py) || (tx==nx && ty==ny) )
 			continue;
+		bool isOutside=(cy-py)*(tx-px)-(cx-px)*(ty-py)>0.0 ||
+			(ny-cy)*(tx-cx)-(nx-cx)*(ty-cy)>0.0 ||
+			(py-ny)*(tx-nx)-(px-nx)*(ty-ny)>0.0;
+		if(isOutside==false){
+			arena.isEar[vertex]=false;
+			return;
 		}
-		ia+=1;
 	}
-	//Converting particle index polygon collection  to QParticle polygon collection  
-	for (size_t i=0;i<subPolygons.size();i++ ){
-		vector<QParticle*> poly;
-		for(size_t n=0;n<subPolygons[i].size();n++ ){
-			int pIndex=subPolygons[i][n];
-			poly.push_back(polygonParticles[pIndex] );
-			
-		}
-		polygons.push_back(poly);
+}
+
+bool QMesh::TriangulateDecompositionArena(DecompositionArena &arena)
+{
+	int pointCount=arena.xs.size();
+	arena.previous.resize(pointCount);
+	arena.next.resize(pointCount);
+	arena.isActive.assign(pointCount,1);
+	arena.isConvex.resize(pointCount);
+	arena.isEar.resize(pointCount);
+	arena.angles.resize(pointCount);
+	for(int i=0;i<pointCount;++i){
+		arena.previous[i]=(i-1+pointCount)%pointCount;
+		arena.next[i]=(i+1)%pointCount;
+	}
+	//The convexity of all vertices is required before the ear tests.
+	for(int i=0;i<pointCount;++i){
+		int pi=arena.previous[i];
+		int ni=arena.next[i];
+		arena.isConvex[i]=(arena.ys[ni]-arena.ys[pi])*(arena.xs[i]-arena.xs[pi])-(arena.xs[ni]-arena.xs[pi])*(arena.ys[i]-arena.ys[pi])>0.0;
+	}
+	for(int i=0;i<pointCount;++i){
+		UpdateDecompositionArenaVertex(arena,i);
 	}
 
-	
+	int triangleCount=pointCount-2;
+	if((int)arena.polygons.size()<triangleCount)
+		arena.polygons.resize(triangleCount);
+	arena.polygonCount=0;
 
+	for(int i=0;i<triangleCount-1;++i){
+		//Finding the most extruded ear
+		int ear=-1;
+		for(int n=0;n<pointCount;++n){
+			if(arena.isActive[n]==false || arena.isEar[n]==false)
+				continue;
+			if(ear==-1 || arena.angles[n]>arena.angles[ear])
+				ear=n;
+		}
+		if(ear==-1)
+			return false;
+
+		int pi=arena.previous[ear];
+		int ni=arena.next[ear];
+		vector<int> &triangle=arena.polygons[arena.polygonCount++];
+		triangle.resize(3);
+		triangle[0]=pi;
+		triangle[1]=ear;
+		triangle[2]=ni;
+
+		arena.isActive[ear]=false;
+		arena.next[pi]=ni;
+		arena.previous[ni]=pi;
+
+		if(i==triangleCount-2)
+			break;
+
+		UpdateDecompositionArenaVertex(arena,pi);
+		UpdateDecompositionArenaVertex(arena,ni);
+	}
+	for(int n=0;n<pointCount;++n){
+		if(arena.isActive[n]){
+			vector<int> &triangle=arena.polygons[arena.polygonCount++];
+			triangle.resize(3);
+			triangle[0]=arena.previous[n];
+			triangle[1]=n;
+			triangle[2]=arena.next[n];
+			break;
+		}
+	}
+	return true;
 }
 
-void QMesh::DecompositePolygon(vector<QParticle *> &polygonParticles, vector<vector<QParticle *>> &polygons)
+int QMesh::FindDecompositionArenaEdge(DecompositionArena &arena, int from, int to)
 {
-	vector<QVector> polygon;
-	for (int i=0;i<polygonParticles.size();++i ){
-		polygon.push_back(polygonParticles[i]->GetGlobalPosition() );
+	for(int e=arena.firstEdges[from];e!=-1;e=arena.nextEdges[e]){
+		if(arena.edgeTargets[e]==to && arena.edgeOwners[e]!=-1)
+			return e;
 	}
-	
-	list<TPPLPoly> in_poly;
-	list<TPPLPoly> out_poly;
-	
+	return -1;
+}
 
-	TPPLPoly inp;
-	inp.Init(polygon.size());
-	for (int i = 0; i < polygon.size(); i++) {
-		TPPLPoint point;
-		point.x=polygon[i].x;
-		point.y=polygon[i].y;
-		inp.GetPoint(i) = point;
-		inp.GetPoint(i).id=i;
-	}
-	inp.SetOrientation(TPPL_ORIENTATION_CCW);
-	in_poly.push_back(inp);
-	TPPLPartition tpart;
-	if (tpart.ConvexPartition_HM(&in_poly, &out_poly) == 0) { // Failed.
-		cout<<"QuarkPhysics Error: Convex decomposing failed!"<<endl;
-		return;
+void QMesh::MergeDecompositionArenaTriangles(DecompositionArena &arena)
+{
+	int pointCount=arena.xs.size();
+	int polygonCount=arena.polygonCount;
+	arena.isPolygonAlive.assign(polygonCount,1);
+
+	//Linking the directed edges of the triangles to their start vertices
+	arena.firstEdges.assign(pointCount,-1);
+	arena.edgeTargets.resize(polygonCount*3);
+	arena.edgeOwners.resize(polygonCount*3);
+	arena.nextEdges.resize(polygonCount*3);
+	int edgeCount=0;
+	for(int i=0;i<polygonCount;++i){
+		vector<int> &triangle=arena.polygons[i];
+		for(int n=0;n<3;++n){
+			int from=triangle[n];
+			arena.edgeTargets[edgeCount]=triangle[ (n+1)%3 ];
+			arena.edgeOwners[edgeCount]=i;
+			arena.nextEdges[edgeCount]=arena.firstEdges[from];
+			arena.firstEdges[from]=edgeCount;
+			edgeCount+=1;
+		}
 	}
 
-	for (auto poly:out_poly){
-		vector<QParticle*> qpoly;
-		for(int i=0;i<poly.GetNumPoints();++i){
-			int point_index=poly.GetPoint(i).id;
-			qpoly.push_back(polygonParticles[point_index]);
-			
+	//Removing the diagonals if the merged polygon is still convex (Hertel-Mehlhorn)
+	for(int i=0;i<polygonCount;++i){
+		if(arena.isPolygonAlive[i]==false)
+			continue;
+		for(int i11=0;i11<(int)arena.polygons[i].size();++i11){
+			vector<int> &poly1=arena.polygons[i];
+			int size1=poly1.size();
+			int i12=(i11+1)%size1;
+			int d1=poly1[i11];
+			int d2=poly1[i12];
+
+			//The same diagonal in the reverse direction belongs to the neighbor polygon.
+			int edge=FindDecompositionArenaEdge(arena,d2,d1);
+			if(edge==-1)
+				continue;
+			int n=arena.edgeOwners[edge];
+			if(n<=i)
+				continue;
+			vector<int> &poly2=arena.polygons[n];
+			int size2=poly2.size();
+			int i21=0;
+			while(poly2[i21]!=d2 || poly2[ (i21+1)%size2 ]!=d1)
+				i21+=1;
+			int i22=(i21+1)%size2;
+
+			int p1=poly1[ (i11-1+size1)%size1 ];
+			int p3=poly2[ (i22+1)%size2 ];
+			if( (arena.ys[p3]-arena.ys[p1])*(arena.xs[d1]-arena.xs[p1])-(arena.xs[p3]-arena.xs[p1])*(arena.ys[d1]-arena.ys[p1])<=0.0 )
+				continue;
+			p1=poly2[ (i21-1+size2)%size2 ];
+			p3=poly1[ (i12+1)%size1 ];
+			if( (arena.ys[p3]-arena.ys[p1])*(arena.xs[d2]-arena.xs[p1])-(arena.xs[p3]-arena.xs[p1])*(arena.ys[d2]-arena.ys[p1])<=0.0 )
+				continue;
+
+			//The edges of the neighbor polygon are moved to the merged polygon.
+			for(int k=0;k<size2;++k){
+				int e=FindDecompositionArenaEdge(arena,poly2[k],poly2[ (k+1)%size2 ]);
+				arena.edgeOwners[e]=i;
+			}
+			arena.edgeOwners[edge]=-1;
+			arena.edgeOwners[ FindDecompositionArenaEdge(arena,d1,d2) ]=-1;
+
+			arena.mergedPolygon.clear();
+			for(int j=i12;j!=i11;j=(j+1)%size1){
+				arena.mergedPolygon.push_back(poly1[j]);
+			}
+			for(int j=i22;j!=i21;j=(j+1)%size2){
+				arena.mergedPolygon.push_back(poly2[j]);
+			}
+			poly1.swap(arena.mergedPolygon);
+			arena.isPolygonAlive[n]=false;
+			i11=-1;
 		}
-		polygons.push_back(qpoly);
 	}
-	
-
-	
 }
 
 //Springs
@@ -669,10 +1476,7 @@ void QMesh::DecompositePolygon(vector<QParticle *> &polygonParticles, vector<vec
 QMesh *QMesh::AddSpring(QSpring *spring)
 {
 	springs.push_back(spring);
-	if(spring->GetParticleA()!=nullptr || spring->GetParticleB()!=nullptr){
-		spring->GetParticleA()->springConnectedParticles.insert(spring->GetParticleB() );
-		spring->GetParticleB()->springConnectedParticles.insert(spring->GetParticleA() );
-	}
+	springAdjacencyNeedsRebuild=true;
 	collisionBehaviorNeedsUpdate=true;
 	return this;
 }
@@ -688,12 +1492,8 @@ QMesh *QMesh::RemoveSpring(QSpring *spring)
 
 QMesh *QMesh::RemoveSpringAt(int index)
 {
-	QSpring *spring=springs[index];
-
-	spring->GetParticleA()->springConnectedParticles.erase(spring->GetParticleB() );
-	spring->GetParticleB()->springConnectedParticles.erase(spring->GetParticleA() );
-	
 	springs.erase(springs.begin()+index);
+	springAdjacencyNeedsRebuild=true;
 	collisionBehaviorNeedsUpdate=true;
 	return this;
 }
@@ -713,6 +1513,481 @@ QMesh *QMesh::RemoveMatchingSprings(QParticle *particle)
 	return this;
 }
 
+void QMesh::BuildSpringAdjacency()
+{
+	int particleCount=particles.size();
+	for(int i=0;i<particleCount;++i){
+		particles[i]->springAdjacencyRow=i;
+	}
+
+	//The connection counts of the rows, then their offsets
+	springAdjacencyOffsets.assign(particleCount+1,0);
+	for(size_t i=0;i<springs.size();++i){
+		QParticle *pA=springs[i]->GetParticleA();
+		QParticle *pB=springs[i]->GetParticleB();
+		if(pA==nullptr || pB==nullptr)
+			continue;
+		if(pA->ownerMesh==this)
+			springAdjacencyOffsets[pA->springAdjacencyRow+1]+=1;
+		if(pB->ownerMesh==this)
+			springAdjacencyOffsets[pB->springAdjacencyRow+1]+=1;
+	}
+	for(int i=0;i<particleCount;++i){
+		springAdjacencyOffsets[i+1]+=springAdjacencyOffsets[i];
+	}
+
+	springAdjacentParticles.resize(springAdjacencyOffsets[particleCount]);
+	//The offsets are used as the insertion cursors and restored after
+	for(size_t i=0;i<springs.size();++i){
+		QParticle *pA=springs[i]->GetParticleA();
+		QParticle *pB=springs[i]->GetParticleB();
+		if(pA==nullptr || pB==nullptr)
+			continue;
+		if(pA->ownerMesh==this)
+			springAdjacentParticles[springAdjacencyOffsets[pA->springAdjacencyRow]++]=pB;
+		if(pB->ownerMesh==this)
+			springAdjacentParticles[springAdjacencyOffsets[pB->springAdjacencyRow]++]=pA;
+	}
+	for(int i=particleCount;i>0;--i){
+		springAdjacencyOffsets[i]=springAdjacencyOffsets[i-1];
+	}
+	springAdjacencyOffsets[0]=0;
+
+	springAdjacencyNeedsRebuild=false;
+}
+
+bool QMesh::CheckSpringAdjacency(QParticle *particle, QParticle *otherParticle)
+{
+	if(springAdjacencyNeedsRebuild)
+		BuildSpringAdjacency();
+	int row=particle->springAdjacencyRow;
+	if(row<0 || row>=(int)particles.size() || particles[row]!=particle)
+		return false;
+	for(int i=springAdjacencyOffsets[row];i<springAdjacencyOffsets[row+1];++i){
+		if(springAdjacentParticles[i]==otherParticle)
+			return true;
+	}
+	return false;
+}
+
+void QMesh::UpdateLocalBounds()
+{
+	localBoundsMin=QVector(QWorld::MAX_WORLD_SIZE,QWorld::MAX_WORLD_SIZE);
+	localBoundsMax=QVector(-QWorld::MAX_WORLD_SIZE,-QWorld::MAX_WORLD_SIZE);
+	for(size_t i=0;i<particles.size();++i){
+		QParticle *particle=particles[i];
+		//The same radius rule with QBody::UpdateAABB()
+		float r=particle->GetRadius()>0.5f ? particle->GetRadius():0;
+		QVector pos=particle->GetPosition();
+		localBoundsMin.x=min(localBoundsMin.x,pos.x-r);
+		localBoundsMin.y=min(localBoundsMin.y,pos.y-r);
+		localBoundsMax.x=max(localBoundsMax.x,pos.x+r);
+		localBoundsMax.y=max(localBoundsMax.y,pos.y+r);
+	}
+	//The bounding circle around the center of the bounds
+	localBoundingCenter=(localBoundsMin+localBoundsMax)*0.5f;
+	localBoundingRadius=0.0f;
+	for(size_t i=0;i<particles.size();++i){
+		QParticle *particle=particles[i];
+		float r=particle->GetRadius()>0.5f ? particle->GetRadius():0;
+		localBoundingRadius=max(localBoundingRadius,(particle->GetPosition()-localBoundingCenter).Length()+r);
+	}
+	localBoundsNeedsUpdate=false;
+}
+
+vector<QParticle *> &QMesh::GetShapeMatchingParticles()
+{
+	if(GetCollisionBehavior()==CollisionBehaviors::POLYLINE)
+		return polygon;
+	return particles;
+}
+
+void QMesh::UpdateShapeMatchingRestPositions()
+{
+	vector<QParticle*> &collection=GetShapeMatchingParticles();
+	shapeMatchingRestPositionsOfPolygon=&collection==&polygon;
+	shapeMatchingRestPositions.resize(collection.size() );
+	shapeMatchingRestPositionsNeedsUpdate=false;
+	if(collection.empty() )
+		return;
+
+	QVector localCenterPosition=QVector::Zero();
+	for(size_t i=0;i<collection.size();++i){
+		localCenterPosition+=collection[i]->GetPosition();
+	}
+	localCenterPosition/=collection.size();
+	for(size_t i=0;i<collection.size();++i){
+		shapeMatchingRestPositions[i]=collection[i]->GetPosition()-localCenterPosition;
+	}
+}
+
+int QMesh::FindParticleIndex(QParticle *particle, int hint)
+{
+	if(hint>=0 && hint<(int)particles.size() && particles[hint]==particle)
+		return hint;
+	for(size_t i=0;i<particles.size();++i){
+		if(particles[i]==particle)
+			return (int)i;
+	}
+	return -1;
+}
+
+void QMesh::RefreshPackedSprings(bool passivationOfInternalSprings)
+{
+	PackedSprings &ps=packedSprings;
+	size_t springCount=springs.size();
+	size_t particleCount=particles.size();
+	ps.particleIndexesA.resize(springCount);
+	ps.particleIndexesB.resize(springCount);
+	ps.lengths.resize(springCount);
+	ps.minimumLengths.resize(springCount);
+	ps.maximumLengths.resize(springCount);
+	ps.responsesA.resize(springCount);
+	ps.responsesB.resize(springCount);
+	ps.correctionsX.resize(springCount);
+	ps.correctionsY.resize(springCount);
+	ps.unpackedSprings.clear();
+	ps.particleIndexHintsA.resize(springCount,-1);
+	ps.particleIndexHintsB.resize(springCount,-1);
+	ps.positionsX.resize(particleCount);
+	ps.positionsY.resize(particleCount);
+	ps.forcesX.resize(particleCount);
+	ps.forcesY.resize(particleCount);
+	ps.forceScales.assign(particleCount,0.0f);
+
+	int n=0;
+	for(size_t i=0;i<springCount;++i){
+		QSpring *spring=springs[i];
+		if(spring->GetEnabled()==false)
+			continue;
+		QParticle *pA=spring->GetParticleA();
+		QParticle *pB=spring->GetParticleB();
+		if(pA==nullptr || pB==nullptr)
+			continue;
+		if(passivationOfInternalSprings && spring->GetIsInternal() ){
+			ps.unpackedSprings.push_back(spring);
+			continue;
+		}
+		int indexA=ps.particleIndexHintsA[i];
+		if(indexA<0 || indexA>=(int)particleCount || particles[indexA]!=pA ){
+			indexA=FindParticleIndex(pA,indexA);
+			ps.particleIndexHintsA[i]=indexA;
+		}
+		int indexB=ps.particleIndexHintsB[i];
+		if(indexB<0 || indexB>=(int)particleCount || particles[indexB]!=pB ){
+			indexB=FindParticleIndex(pB,indexB);
+			ps.particleIndexHintsB[i]=indexB;
+		}
+		if(indexA==-1 || indexB==-1){
+			ps.unpackedSprings.push_back(spring);
+			continue;
+		}
+
+		bool particleACanGetResponse=pA->GetEnabled();
+		bool particleBCanGetResponse=pB->GetEnabled();
+		if(particleACanGetResponse==false && particleBCanGetResponse==false)
+			continue;
+		float k=(particleACanGetResponse && particleBCanGetResponse) ? 0.5f:1.0f;
+
+		float length=spring->GetLength();
+		ps.particleIndexesA[n]=indexA;
+		ps.particleIndexesB[n]=indexB;
+		ps.lengths[n]=length;
+		if(spring->GetDistanceLimitEnabled() ){
+			ps.minimumLengths[n]=length*spring->GetMinimumDistanceFactor();
+			ps.maximumLengths[n]=length*spring->GetMaximumDistanceFactor();
+		}else{
+			ps.minimumLengths[n]=0.0f;
+			ps.maximumLengths[n]=numeric_limits<float>::max();
+		}
+		ps.responsesA[n]=particleACanGetResponse ? k:0.0f;
+		ps.responsesB[n]=particleBCanGetResponse ? k:0.0f;
+		//The correction counts of the particles
+		if(particleACanGetResponse)
+			ps.forceScales[indexA]+=1.0f;
+		if(particleBCanGetResponse)
+			ps.forceScales[indexB]+=1.0f;
+		++n;
+	}
+	ps.springCount=n;
+
+	for(size_t i=0;i<particleCount;++i){
+		if(ps.forceScales[i]>0.0f)
+			ps.forceScales[i]=packedConstraintsRelaxation/ps.forceScales[i];
+	}
+}
+
+void QMesh::SolvePackedSprings(float rigidity)
+{
+	PackedSprings &ps=packedSprings;
+	int springCount=ps.springCount;
+	if(springCount==0 || rigidity==0.0f)
+		return;
+	int particleCount=particles.size();
+	if((int)ps.positionsX.size()!=particleCount)
+		return;
+
+	float *positionsX=ps.positionsX.data();
+	float *positionsY=ps.positionsY.data();
+	float *forcesX=ps.forcesX.data();
+	float *forcesY=ps.forcesY.data();
+	for(int i=0;i<particleCount;++i){
+		QVector position=particles[i]->GetGlobalPosition();
+		positionsX[i]=position.x;
+		positionsY[i]=position.y;
+		forcesX[i]=0.0f;
+		forcesY[i]=0.0f;
+	}
+
+	const int *indexesA=ps.particleIndexesA.data();
+	const int *indexesB=ps.particleIndexesB.data();
+	const float *lengths=ps.lengths.data();
+	const float *minimumLengths=ps.minimumLengths.data();
+	const float *maximumLengths=ps.maximumLengths.data();
+	const float *responsesA=ps.responsesA.data();
+	const float *responsesB=ps.responsesB.data();
+	float *correctionsX=ps.correctionsX.data();
+	float *correctionsY=ps.correctionsY.data();
+
+	//The corrections of the springs are computed from the positions of the beginning of the solve (Jacobi).
+	for(int i=0;i<springCount;++i){
+		float dx=positionsX[indexesB[i]]-positionsX[indexesA[i]];
+		float dy=positionsY[indexesB[i]]-positionsY[indexesA[i]];
+		float distance=sqrtf(dx*dx+dy*dy);
+		float invDistance=distance>0.0f ? 1.0f/distance:0.0f;
+		float k=(distance>maximumLengths[i] || distance<minimumLengths[i]) ? 1.0f:rigidity;
+		float factor=(lengths[i]-distance)*invDistance*k;
+		correctionsX[i]=dx*factor;
+		correctionsY[i]=dy*factor;
+	}
+
+	//The particles that can't get a response have a zero share.
+	for(int i=0;i<springCount;++i){
+		int a=indexesA[i];
+		int b=indexesB[i];
+		forcesX[a]-=correctionsX[i]*responsesA[i];
+		forcesY[a]-=correctionsY[i]*responsesA[i];
+		forcesX[b]+=correctionsX[i]*responsesB[i];
+		forcesY[b]+=correctionsY[i]*responsesB[i];
+	}
+
+	//The corrections are averaged like the accumulated forces of the particles and over relaxed to converge faster.
+	const float *forceScales=ps.forceScales.data();
+	for(int i=0;i<particleCount;++i){
+		if(forceScales[i]==0.0f)
+			continue;
+		particles[i]->ApplyForce(QVector(forcesX[i]*forceScales[i],forcesY[i]*forceScales[i]) );
+	}
+}
+
+void QMesh::RefreshPackedAngleConstraints()
+{
+	PackedAngleConstraints &pa=packedAngleConstraints;
+	size_t constraintCount=angleConstraints.size();
+	size_t particleCount=particles.size();
+	pa.constraints.resize(constraintCount);
+	pa.particleIndexesA.resize(constraintCount);
+	pa.particleIndexesB.resize(constraintCount);
+	pa.particleIndexesC.resize(constraintCount);
+	pa.minAngles.resize(constraintCount);
+	pa.maxAngles.resize(constraintCount);
+	pa.minAnglesX.resize(constraintCount);
+	pa.minAnglesY.resize(constraintCount);
+	pa.maxAnglesX.resize(constraintCount);
+	pa.maxAnglesY.resize(constraintCount);
+	pa.rigidities.resize(constraintCount);
+	pa.previousAngles.resize(constraintCount);
+	pa.responsesA.resize(constraintCount);
+	pa.responsesC.resize(constraintCount);
+	pa.correctionsAX.resize(constraintCount);
+	pa.correctionsAY.resize(constraintCount);
+	pa.correctionsCX.resize(constraintCount);
+	pa.correctionsCY.resize(constraintCount);
+	pa.unpackedConstraints.clear();
+	pa.particleIndexHintsA.resize(constraintCount,-1);
+	pa.particleIndexHintsB.resize(constraintCount,-1);
+	pa.particleIndexHintsC.resize(constraintCount,-1);
+	pa.positionsX.resize(particleCount);
+	pa.positionsY.resize(particleCount);
+	pa.forcesX.resize(particleCount);
+	pa.forcesY.resize(particleCount);
+	pa.forceScales.assign(particleCount,0.0f);
+
+	int n=0;
+	for(size_t i=0;i<constraintCount;++i){
+		QAngleConstraint *constraint=angleConstraints[i];
+		if(constraint->GetEnabled()==false)
+			continue;
+		QParticle *pA=constraint->GetParticleA();
+		QParticle *pB=constraint->GetParticleB();
+		QParticle *pC=constraint->GetParticleC();
+		if(pA==nullptr || pB==nullptr || pC==nullptr)
+			continue;
+		int indexA=FindParticleIndex(pA,pa.particleIndexHintsA[i]);
+		int indexB=FindParticleIndex(pB,pa.particleIndexHintsB[i]);
+		int indexC=FindParticleIndex(pC,pa.particleIndexHintsC[i]);
+		pa.particleIndexHintsA[i]=indexA;
+		pa.particleIndexHintsB[i]=indexB;
+		pa.particleIndexHintsC[i]=indexC;
+		if(indexA==-1 || indexB==-1 || indexC==-1){
+			pa.unpackedConstraints.push_back(constraint);
+			continue;
+		}
+
+		//The first angle of the constraint is saved like the first update of the constraint
+		QVector toPrev=pA->GetGlobalPosition()-pB->GetGlobalPosition();
+		QVector toNext=pC->GetGlobalPosition()-pB->GetGlobalPosition();
+		if(constraint->beginToSaveAngles){
+			constraint->UpdateCurrentAngle(toPrev,toNext);
+		}
+
+		float minAngle=constraint->GetMinAngle();
+		float maxAngle=constraint->GetMaxAngle();
+		pa.constraints[n]=constraint;
+		pa.particleIndexesA[n]=indexA;
+		pa.particleIndexesB[n]=indexB;
+		pa.particleIndexesC[n]=indexC;
+		pa.minAngles[n]=minAngle;
+		pa.maxAngles[n]=maxAngle;
+		pa.minAnglesX[n]=cos(minAngle);
+		pa.minAnglesY[n]=sin(minAngle);
+		pa.maxAnglesX[n]=cos(maxAngle);
+		pa.maxAnglesY[n]=sin(maxAngle);
+		pa.rigidities[n]=constraint->GetRigidity();
+		pa.previousAngles[n]=constraint->prevAngle;
+		pa.responsesA[n]=pA->GetEnabled() ? 1.0f:0.0f;
+		pa.responsesC[n]=pC->GetEnabled() ? 1.0f:0.0f;
+		if(pA->GetEnabled() )
+			pa.forceScales[indexA]+=1.0f;
+		if(pC->GetEnabled() )
+			pa.forceScales[indexC]+=1.0f;
+		++n;
+	}
+	pa.constraintCount=n;
+
+	for(size_t i=0;i<particleCount;++i){
+		if(pa.forceScales[i]>0.0f)
+			pa.forceScales[i]=packedConstraintsRelaxation/pa.forceScales[i];
+	}
+}
+
+void QMesh::SolvePackedAngleConstraints(float timeScale)
+{
+	PackedAngleConstraints &pa=packedAngleConstraints;
+	int constraintCount=pa.constraintCount;
+	if(constraintCount==0)
+		return;
+	int particleCount=particles.size();
+	if((int)pa.positionsX.size()!=particleCount)
+		return;
+
+	float *positionsX=pa.positionsX.data();
+	float *positionsY=pa.positionsY.data();
+	float *forcesX=pa.forcesX.data();
+	float *forcesY=pa.forcesY.data();
+	for(int i=0;i<particleCount;++i){
+		QVector position=particles[i]->GetGlobalPosition();
+		positionsX[i]=position.x;
+		positionsY[i]=position.y;
+		forcesX[i]=0.0f;
+		forcesY[i]=0.0f;
+	}
+
+	const int *indexesA=pa.particleIndexesA.data();
+	const int *indexesB=pa.particleIndexesB.data();
+	const int *indexesC=pa.particleIndexesC.data();
+	const float *minAngles=pa.minAngles.data();
+	const float *maxAngles=pa.maxAngles.data();
+	const float *minAnglesX=pa.minAnglesX.data();
+	const float *minAnglesY=pa.minAnglesY.data();
+	const float *maxAnglesX=pa.maxAnglesX.data();
+	const float *maxAnglesY=pa.maxAnglesY.data();
+	const float *rigidities=pa.rigidities.data();
+	const float *responsesA=pa.responsesA.data();
+	const float *responsesC=pa.responsesC.data();
+	float *previousAngles=pa.previousAngles.data();
+	float *correctionsAX=pa.correctionsAX.data();
+	float *correctionsAY=pa.correctionsAY.data();
+	float *correctionsCX=pa.correctionsCX.data();
+	float *correctionsCY=pa.correctionsCY.data();
+	const float twoPi=(float)(M_PI*2.0);
+	const float invTwoPi=(float)(1.0/(M_PI*2.0));
+
+	//The corrections of the arms are computed from the dot and cross products of the arms, the rotations are applied as complex numbers.
+	for(int i=0;i<constraintCount;++i){
+		float bx=positionsX[indexesB[i]];
+		float by=positionsY[indexesB[i]];
+		float toPrevX=positionsX[indexesA[i]]-bx;
+		float toPrevY=positionsY[indexesA[i]]-by;
+		float toNextX=positionsX[indexesC[i]]-bx;
+		float toNextY=positionsY[indexesC[i]]-by;
+
+		//The angle as a complex number, cos and sin multiplied by the lengths
+		float dot=toNextX*toPrevX+toNextY*toPrevY;
+		float cross=toNextX*toPrevY-toNextY*toPrevX;
+
+		//The continuous angle is the closest turn of the angle to the previous one
+		float angle=ApproximateAtan2(cross,dot);
+		angle=angle<0.0f ? angle+twoPi:angle;
+		angle+=twoPi*ApproximateFloor( (previousAngles[i]-angle)*invTwoPi+0.5f );
+		previousAngles[i]=angle;
+
+		bool isOverMax=angle>maxAngles[i];
+		bool isUnderMin=angle<minAngles[i];
+		float diffAngle=isOverMax ? maxAngles[i]-angle:(isUnderMin ? minAngles[i]-angle:0.0f);
+
+		//The rotation of the difference is the limit rotation multiplied by the conjugate of the angle rotation
+		float lengthProduct=sqrtf(dot*dot+cross*cross);
+		float invLengthProduct=lengthProduct>0.0f ? 1.0f/lengthProduct:0.0f;
+		float cosAngle=dot*invLengthProduct;
+		float sinAngle=cross*invLengthProduct;
+		float limitX=isOverMax ? maxAnglesX[i]:minAnglesX[i];
+		float limitY=isOverMax ? maxAnglesY[i]:minAnglesY[i];
+		float cosDiff=limitX*cosAngle+limitY*sinAngle;
+
+		//The half of the difference with the half angle identities, the signs come from the half angle in the [-PI,PI) range
+		float halfAngle=diffAngle*0.5f;
+		halfAngle-=twoPi*ApproximateFloor(halfAngle*invTwoPi+0.5f);
+		float cosHalf=sqrtf(fmax(0.0f,(1.0f+cosDiff)*0.5f) );
+		float sinHalf=sqrtf(fmax(0.0f,(1.0f-cosDiff)*0.5f) );
+		cosHalf=fabs(halfAngle)<(float)M_PI_2 ? cosHalf:-cosHalf;
+		sinHalf=halfAngle<0.0f ? -sinHalf:sinHalf;
+		cosHalf=diffAngle==0.0f ? 1.0f:cosHalf;
+		sinHalf=diffAngle==0.0f ? 0.0f:sinHalf;
+
+		float rigidity=rigidities[i]*timeScale;
+		rigidity=(rigidity>=0.0f && rigidity<=1.0f) ? rigidity:rigidities[i];
+
+		//toPrev is rotated by the half difference and toNext by the negative of it
+		correctionsAX[i]=(toPrevX*cosHalf-toPrevY*sinHalf-toPrevX)*rigidity*responsesA[i];
+		correctionsAY[i]=(toPrevX*sinHalf+toPrevY*cosHalf-toPrevY)*rigidity*responsesA[i];
+		correctionsCX[i]=(toNextX*cosHalf+toNextY*sinHalf-toNextX)*rigidity*responsesC[i];
+		correctionsCY[i]=(-toNextX*sinHalf+toNextY*cosHalf-toNextY)*rigidity*responsesC[i];
+	}
+
+	for(int i=0;i<constraintCount;++i){
+		int a=indexesA[i];
+		int c=indexesC[i];
+		forcesX[a]+=correctionsAX[i];
+		forcesY[a]+=correctionsAY[i];
+		forcesX[c]+=correctionsCX[i];
+		forcesY[c]+=correctionsCY[i];
+	}
+
+	const float *forceScales=pa.forceScales.data();
+	for(int i=0;i<particleCount;++i){
+		if(forceScales[i]==0.0f)
+			continue;
+		particles[i]->ApplyForce(QVector(forcesX[i]*forceScales[i],forcesY[i]*forceScales[i]) );
+	}
+
+	//The angles are written back to the constraints
+	for(int i=0;i<constraintCount;++i){
+		pa.constraints[i]->prevAngle=previousAngles[i];
+		pa.constraints[i]->currentAngle=previousAngles[i];
+	}
+}
+
 //UV Maps
 
 QMesh *QMesh::AddUVMap(vector<int> map)
@@ -1270,7 +2545,7 @@ QMesh::MeshData QMesh::GeneratePolygonMeshData(float radius, int sideCount, QVec
 }
 
 
-pair<QVector, float> QMesh::GetAveragePositionAndRotation(vector<QParticle *> particleCollection)
+pair<QVector, float> QMesh::GetAveragePositionAndRotation(const vector<QParticle *> &particleCollection)
 {
     if(particleCollection.size()==1)
 		return pair<QVector, float>(particleCollection[0]->GetGlobalPosition(),0.0f);
@@ -1302,7 +2577,7 @@ pair<QVector, float> QMesh::GetAveragePositionAndRotation(vector<QParticle *> pa
 	return pair< QVector, float >(averagePosition,averageRotation);
 }
 
-vector<QVector> QMesh::GetMatchingParticlePositions(vector<QParticle *> particleCollection, QVector targetPosition, float targetRotation)
+vector<QVector> QMesh::GetMatchingParticlePositions(const vector<QParticle *> &particleCollection, QVector targetPosition, float targetRotation)
 {
     QVector localCenterPosition;
 	QVector globalCenterPosition;
@@ -1312,12 +2587,13 @@ vector<QVector> QMesh::GetMatchingParticlePositions(vector<QParticle *> particle
 	localCenterPosition/=particleCollection.size();
 
 	vector<QVector> positions;
+	positions.reserve(particleCollection.size() );
 	for(int n=0;n<particleCollection.size();n++){
 		QParticle * particle=particleCollection[n];
 		
 		QVector targetPos=(particle->GetPosition()-localCenterPosition).Rotated(-targetRotation);
 		targetPos+=targetPosition;
-		//particle->GetOwnerMesh()->GetOwnerBody()->GetWorld()->GetGizmos()->push_back(new QGizmoCircle(targetPos,3.0f) );
+		//particle->GetOwnerMesh()->GetOwnerBody()->GetWorld()->GetGizmos()->AddCircle(targetPos,3.0f);
 		positions.push_back(targetPos);
 	}
 
@@ -32,9 +32,11 @@
 #include "qspring.h"
 #include "qparticle.h"
 #include "qangleconstraint.h"
+#include "qcollision.h"
 #include "json/json.hpp"
 #include "fstream"
 #include "qmath_utils.h"
+#include <future>
 
 using json =nlohmann::json;
 
@@ -65,7 +67,24 @@ protected:
 	vector<QAngleConstraint*> angleConstraints=vector<QAngleConstraint*>();
 	vector <QParticle*> polygon=vector<QParticle*>();
 	vector<vector<QParticle*>> subConvexPolygons=vector<vector<QParticle*>>();
+	vector<QCollision::ConvexPolygonCache> subConvexPolygonCaches;
+	//The node of the small bounding volume hierarchies of the mesh. Children are always stored after their parents, so the trees are refitted in reverse order.
+	struct BVHNode{
+		QAABB aabb;
+		int left=-1;
+		int right=-1;
+		int leafIndex=-1;
+	};
+	//The bounding volume hierarchy over the sub polygons.
+	vector<BVHNode> subConvexPolygonBVH;
+	//The bounding volume hierarchy over the segments of the polygon. The leaf at index i is the segment between the polygon particles i and i+1. The leaves are in the segment order from left to right.
+	vector<BVHNode> polygonSegmentBVH;
+	//The convex hull of the concave polygons of rigid meshes. It's an early out before the sub polygon tests.
+	vector<QParticle*> convexHull;
+	QCollision::ConvexPolygonCache convexHullCache;
 	vector<QVector> polygonBisectors;
+	//The segment indexes hit by the bisectors in the last update. They're tested first in the next update.
+	vector<int> polygonBisectorHitSegments;
 	float circumference=0.0f;
 	QBody *ownerBody=nullptr;
 	CollisionBehaviors collisionBehavior=CollisionBehaviors::CIRCLES;
@@ -75,6 +94,36 @@ protected:
 
 	bool collisionBehaviorNeedsUpdate=false;
 
+	//The particles in the order of the sweep and prune tests. It's kept between the steps, so it's almost sorted in the next test.
+	vector<QParticle*> sortedParticles;
+	bool sortedParticlesNeedsRebuild=true;
+	//The order of the first particle of the mesh in the particle grid of the world. If the mesh isn't in the grid, it's -1.
+	int particleGridOffset=-1;
+
+	//The spring connections of the particles in the compressed sparse row format. The connections of the particle at the row i are between springAdjacencyOffsets[i] and springAdjacencyOffsets[i+1]. It's rebuilt when the particles or the springs of the mesh change.
+	vector<int> springAdjacencyOffsets;
+	vector<QParticle*> springAdjacentParticles;
+	bool springAdjacencyNeedsRebuild=true;
+	void BuildSpringAdjacency();
+	bool CheckSpringAdjacency(QParticle *particle,QParticle *otherParticle);
+
+	//The local positions of the shape matching particles relative to their local center. It's updated when the particles, the polygon or the local positions of the particles change.
+	vector<QVector> shapeMatchingRestPositions;
+	bool shapeMatchingRestPositionsOfPolygon=false;
+	bool shapeMatchingRestPositionsNeedsUpdate=true;
+	vector<QParticle*> &GetShapeMatchingParticles();
+	void UpdateShapeMatchingRestPositions();
+
+	//The bounds of the particles in the local space of the mesh, including the particle radii. The AABBs of the rigid bodies are calculated from them without iterating the particles.
+	QVector localBoundsMin=QVector::Zero();
+	QVector localBoundsMax=QVector::Zero();
+	QVector localBoundingCenter=QVector::Zero();
+	float localBoundingRadius=0.0f;
+	bool localBoundsNeedsUpdate=true;
+	//The unit vector of the global rotation that the particles are transformed with in the last QBody::UpdateMeshTransforms() call
+	QVector globalRotationUnit=QVector(1.0f,0.0f);
+	void UpdateLocalBounds();
+
 	//Helper Methods
 	void UpdateCollisionBehavior();
 	
@@ -82,19 +131,167 @@ protected:
 	//Polygon Properties
 	vector<float> lastPolygonCornerAngles;
 	float minAngleConstraintOfPolygon=M_PI*0.3;
+	int polygonSelfIntersectionTestInterval=1;
+	int polygonSelfIntersectionTestCounter=0;
+
+	//Decomposition Properties
+	//A decomposition of the polygon as particle index lists. It's keyed by the reflex corners of the polygon.
+	struct DecompositionCacheEntry{
+		vector<char> convexitySignature;
+		vector<vector<int>> subPolygonIndexes;
+	};
+	static const int DECOMPOSITION_CACHE_SIZE=8;
+	//The sine of the smallest corner angle that is counted as a turn while a cached decomposition is validated.
+	static constexpr float CONVEXITY_TOLERANCE=0.001f;
+	//The cache is cleared when the topology of the polygon changes.
+	vector<DecompositionCacheEntry> decompositionCache;
+	int decompositionCacheNextSlot=0;
+	unsigned int polygonTopologyVersion=0;
+	unsigned int decompositionCacheTopologyVersion=0;
+	//The topology version of the polygon that the current sub polygons belong to.
+	unsigned int subConvexPolygonsTopologyVersion=0;
+	bool asyncDecompositionEnabled=false;
+	future<vector<vector<int>>> pendingDecomposition;
+	vector<char> pendingDecompositionSignature;
+	unsigned int pendingDecompositionTopologyVersion=0;
+	bool decompositionRequestedWhilePending=false;
+	//The reusable buffers of the ear clipping and the Hertel-Mehlhorn merge. Every thread has its own arena, so it works on the worker threads too.
+	struct DecompositionArena{
+		//The vertices in the counter clockwise order
+		vector<double> xs;
+		vector<double> ys;
+		vector<int> polygonIndexes;
+		vector<int> previous;
+		vector<int> next;
+		vector<char> isActive;
+		vector<char> isConvex;
+		vector<char> isEar;
+		vector<double> angles;
+		//The triangles and the merged polygons as vertex lists
+		vector<vector<int>> polygons;
+		vector<char> isPolygonAlive;
+		int polygonCount=0;
+		vector<int> mergedPolygon;
+		//The directed edges of the polygons, linked per start vertex
+		vector<int> edgeTargets;
+		vector<int> edgeOwners;
+		vector<int> nextEdges;
+		vector<int> firstEdges;
+	};
+
+	//Packed Springs
+	//The springs of the mesh in flat arrays for the batched constraint solver of the world. The particles are referred with their indexes in the mesh. It's refreshed once per step, so the changes on the springs are applied in the next step.
+	struct PackedSprings{
+		//The packed springs are the first springCount elements of the arrays.
+		vector<int> particleIndexesA;
+		vector<int> particleIndexesB;
+		vector<float> lengths;
+		//The distance limits, they're 0 and the max float if the distance limit of the spring is disabled.
+		vector<float> minimumLengths;
+		vector<float> maximumLengths;
+		//The shares of the particles from the correction. It's 0.0 if the particle can't get a response.
+		vector<float> responsesA;
+		vector<float> responsesB;
+		//The springs that can't be packed (passivated internal springs and springs to the particles of other meshes) are updated one by one.
+		vector<QSpring*> unpackedSprings;
+		//The particle indexes of the springs in the last refresh. They're checked first instead of searching the particles.
+		vector<int> particleIndexHintsA;
+		vector<int> particleIndexHintsB;
+		//The working buffers of the solver
+		vector<float> positionsX;
+		vector<float> positionsY;
+		vector<float> correctionsX;
+		vector<float> correctionsY;
+		vector<float> forcesX;
+		vector<float> forcesY;
+		//The relaxation factor divided by the correction count of each particle
+		vector<float> forceScales;
+		int springCount=0;
+	};
+	PackedSprings packedSprings;
+	//The angle constraints of the mesh in flat arrays for the batched constraint solver of the world. The angles are compared with dot and cross products, the limits are kept as unit vectors, and the corrections are complex number rotations.
+	struct PackedAngleConstraints{
+		//The packed angle constraints are the first constraintCount elements of the arrays.
+		vector<QAngleConstraint*> constraints;
+		vector<int> particleIndexesA;
+		vector<int> particleIndexesB;
+		vector<int> particleIndexesC;
+		vector<float> minAngles;
+		vector<float> maxAngles;
+		//The unit vectors of the min and max angles
+		vector<float> minAnglesX;
+		vector<float> minAnglesY;
+		vector<float> maxAnglesX;
+		vector<float> maxAnglesY;
+		vector<float> rigidities;
+		//The continuous angles of the last solve
+		vector<float> previousAngles;
+		vector<float> responsesA;
+		vector<float> responsesC;
+		int constraintCount=0;
+		//The angle constraints to the particles of other meshes are updated one by one.
+		vector<QAngleConstraint*> unpackedConstraints;
+		//The particle indexes of the angle constraints in the last refresh, they're indexed like the angle constraints of the mesh. They're checked first instead of searching the particles.
+		vector<int> particleIndexHintsA;
+		vector<int> particleIndexHintsB;
+		vector<int> particleIndexHintsC;
+		//The working buffers of the solver
+		vector<float> positionsX;
+		vector<float> positionsY;
+		vector<float> correctionsAX;
+		vector<float> correctionsAY;
+		vector<float> correctionsCX;
+		vector<float> correctionsCY;
+		vector<float> forcesX;
+		vector<float> forcesY;
+		vector<float> forceScales;
+	};
+	PackedAngleConstraints packedAngleConstraints;
+	int FindParticleIndex(QParticle *particle,int hint);
+	void RefreshPackedSprings(bool passivationOfInternalSprings);
+	void SolvePackedSprings(float rigidity);
+	void RefreshPackedAngleConstraints();
+	void SolvePackedAngleConstraints(float timeScale);
 
 	//Polygon Methods
 	void UpdateSubConvexPolygons(bool majorUpdate=true);
 	void UpdatePolygonBisectors();
-	static vector<QVector> GetBisectors(vector<QParticle*> polygonParticles);
+	void UpdateSubConvexPolygonCaches();
+	static void UpdateConvexPolygonCache(vector<QParticle*> &polygonParticles,QCollision::ConvexPolygonCache &cache,bool isRigid,QVector rotVecUnit,bool updateLocalNormals);
+	void BuildSubConvexPolygonBVH();
+	int BuildSubConvexPolygonBVHNode(vector<int> &polygonIndexes,int begin,int end);
+	void UpdateConvexHull();
+	void UpdatePolygonSegmentBVH();
+	int BuildPolygonSegmentBVHNode(int begin,int end);
+	void GetPolygonSegmentsInAABB(const QAABB &aabb,vector<int> &segmentIndexes);
+	int FindNearestPolygonParticle(QVector point,QParticle *exceptParticle);
+	void UpdatePolygonBisectorsWithSegmentBVH();
+	static void GetBisectors(const vector<QParticle*> &polygonParticles,vector<QVector> &bisectors);
 	void ApplyAngleConstraintsToPolygon();
+	bool CheckIsPolygonSelfIntersected(QVector &intersection);
 	bool CheckIsPolygonConcave(vector<QParticle*> polygonParticles);
 	static bool CheckIsReflex(QVector pA,QVector pB, QVector pC);
 	static bool CheckIsReflex(int indexA,int indexB, int indexC, vector<QParticle*> polygonParticles);
-	static void TriangulatePolygon(vector<QParticle*> &polygonParticles,vector<vector<int>> &triangles);
 	static void DecompositePolygon(vector<QParticle*> &polygonParticles,vector<vector<QParticle*>> &polygons);
-	static void DecompositePolygon2(vector<QParticle*> &polygonParticles,vector<vector<QParticle*>> &polygons);
+	static bool DecompositePolygonPoints(const vector<QVector> &polygonPoints,vector<vector<int>> &subPolygonIndexes);
+	static vector<vector<int>> DecompositeCopiedPolygonPoints(vector<QVector> polygonPoints);
+	//Queues the decomposition of the copied points to the shared decomposition worker thread.
+	static future<vector<vector<int>>> StartAsyncDecomposition(vector<QVector> polygonPoints);
+	static bool TriangulateDecompositionArena(DecompositionArena &arena);
+	static void UpdateDecompositionArenaVertex(DecompositionArena &arena,int vertex);
+	static void MergeDecompositionArenaTriangles(DecompositionArena &arena);
+	static int FindDecompositionArenaEdge(DecompositionArena &arena,int from,int to);
+	void DecompositePolygonWithCache();
+	void GetConvexitySignature(vector<char> &signature);
+	void AddToDecompositionCache(const vector<char> &signature,const vector<vector<int>> &subPolygonIndexes);
+	bool CheckAreSubPolygonIndexesConvex(const vector<vector<int>> &subPolygonIndexes);
+	void SetSubConvexPolygonsFromIndexes(const vector<vector<int>> &subPolygonIndexes);
+	void ApplyPendingDecomposition(bool waitForResult);
 	bool subConvexPolygonsNeedsUpdate=false;
+	bool subConvexPolygonCachesNeedsUpdate=true;
+	bool subConvexPolygonLocalNormalsNeedsUpdate=true;
+	bool subConvexPolygonBVHNeedsUpdate=true;
+	bool polygonSegmentBVHNeedsUpdate=true;
 	bool polygonBisectorsNeedsUpdate=true;
 	bool isPolygonSelfIntersected=false;
 
@@ -317,6 +514,9 @@ public:
 	 * @param particle The index of particle to get.
 	 */
 	QParticle *GetParticleAt(int index);
+	/** Returns the particles of the mesh sorted by the minimum x positions of their bounding boxes. The order is kept between the calls, so it's updated with an insertion sort. 
+	 */
+	vector<QParticle*> &GetParticlesSortedHorizontally();
 
 	/** Returns the index of the specified particle.
 	 * @param particle A particle in the mesh.
@@ -409,6 +609,38 @@ public:
 		return this;
 	}
 
+	/** Returns whether the asynchronous decomposition of the polygon is enabled. */
+	bool GetAsyncDecompositionEnabled(){
+		return asyncDecompositionEnabled;
+	}
+
+	/** Sets whether the concave decomposition of the polygon runs on a worker thread. If it's enabled and the polygon needs a new decomposition after a deformation, the previous sub polygons are used until the worker thread finishes. Changes to the topology of the polygon are always decomposed immediately. 
+	 * The default value is false.
+	 * @param value A boolean value to set.
+	 * @return QMesh* A pointer to mesh itself.
+	*/
+	QMesh *SetAsyncDecompositionEnabled(bool value){
+		asyncDecompositionEnabled=value;
+		return this;
+	}
+
+	/** Returns the step interval of the self intersection test of the polygon. The test is a part of the angle constraints of the polygon.
+	 * The default value is 1.
+	 */
+	int GetPolygonSelfIntersectionTestInterval(){
+		return polygonSelfIntersectionTestInterval;
+	}
+
+	/** Sets the step interval of the self intersection test of the polygon. The test is a part of the angle constraints of the polygon. If the interval is greater than 1, the test runs only every k steps and the last result is used between them. It's useful for the soft bodies with long polygons.
+	 * The default value is 1.
+	 * @param steps The step count between two tests. 
+	 * @return QMesh* A pointer to mesh itself.
+	*/
+	QMesh *SetPolygonSelfIntersectionTestInterval(int steps){
+		polygonSelfIntersectionTestInterval=max(steps,1);
+		return this;
+	}
+
 	
 
 	/** Returns the total sub polygon count in the mesh.
@@ -430,6 +662,19 @@ public:
 		}
 		return subConvexPolygons[index];
 	}
+	/** Returns the cached vertex positions and edge normals of the sub polygon at the specified index. The cache is updated only if the particles of the mesh have moved. 
+	 * @param index The index of the sub polygon.
+	 */
+	QCollision::ConvexPolygonCache &GetSubConvexPolygonCacheAt(int index){
+		UpdateSubConvexPolygonCaches();
+		return subConvexPolygonCaches[index];
+	}
+	/** Returns the convex hull cache of the mesh. It's only available for the rigid meshes with concave polygons, otherwise returns nullptr. 
+	 */
+	QCollision::ConvexPolygonCache *GetConvexHullCache(){
+		UpdateSubConvexPolygonCaches();
+		return convexHull.size()>0 ? &convexHullCache : nullptr;
+	}
 
 	QVector GetPolygonBisectorVectorAt(int index){
 		return polygonBisectors[index];
@@ -701,7 +946,7 @@ public:
 	 * @param particleCollection A Particles collection
 	 * @return Returns a position-rotation pair.
 	 */
-	static pair<QVector, float> GetAveragePositionAndRotation(vector<QParticle*> particleCollection);
+	static pair<QVector, float> GetAveragePositionAndRotation(const vector<QParticle*> &particleCollection);
 
 	/** Returns the non-deformed particle positions based on the target position and rotation. 
 	 * This method is also used for shape matching operations.
@@ -710,7 +955,7 @@ public:
 	 * @param targetRotation  Target center rotation to transformation.
 	 * @return Returns A list of positions.
 	*/
-	static vector<QVector> GetMatchingParticlePositions(vector<QParticle*> particleCollection,QVector targetPosition, float targetRotation);
+	static vector<QVector> GetMatchingParticlePositions(const vector<QParticle*> &particleCollection,QVector targetPosition, float targetRotation);
 
 
 	/**
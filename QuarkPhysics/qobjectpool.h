@@ -35,6 +35,8 @@
 
 using namespace std;
 
+/** @brief QObjectPool keeps the objects in chunked slabs of contiguous storage. The slabs are never reallocated, so the addresses of the nodes and their data are stable during the whole life of the pool. FreeAll() is a constant time operation which rewinds the bump pointer of the pool.
+ */
 template <typename T>
 class QObjectPool {
 public:
@@ -55,113 +57,96 @@ public:
     };
 private:
 
-    /* Node* nodes;
-    size_t size = 2;
-    size_t freeSize = 2;
-    size_t lastFreeNode = -1; */
-
-    void Resize(size_t newSize){
-        QObjectPool<T>::Node* newNodes = new QObjectPool<T>::Node[newSize];
+    struct Slab{
+        Node* nodes;
+        T* objects;
+        size_t size;
+    };
 
-        if(size>0){
-            for (size_t i = 0; i < std::min(size, newSize); ++i) {
-                newNodes[i] = nodes[i];
-            }
-            delete[] nodes;
+    vector<Slab> slabs;
+    //Node pointers indexed by node id. The nodes themselves live in the slabs. 
+    vector<Node*> nodeTable;
+
+    void AddSlab(size_t slabSize){
+        Slab slab;
+        slab.size=slabSize;
+        slab.nodes=new QObjectPool<T>::Node[slabSize];
+        slab.objects=new T[slabSize];
+
+        for (size_t i = 0; i < slabSize; ++i) {
+            Node &node=slab.nodes[i];
+            node.id = size+i;
+            node.next = -1;
+            node.data = &slab.objects[i];
+            nodeTable.push_back(&node);
         }
 
-        for (size_t i = size; i < newSize; ++i) {
-            newNodes[i].next = i + 1;
-            newNodes[i].id = i;
-            newNodes[i].data = new T();
-        }
-        
-        
-        nodes = newNodes;
-        size = newSize;
+        slabs.push_back(slab);
+        size+=slabSize;
     };
 
 public:
     QObjectPool(){
-        nodes = new QObjectPool<T>::Node[size];
-
-        for (size_t i = 0; i < size; ++i) {
-            nodes[i].next = i + 1;
-            nodes[i].id = i;
-            nodes[i].data=new T();
-        }
-
-        nodes[size - 1].next = -1;
-        lastFreeNode = 0;
+        AddSlab(2);
     };
     QObjectPool(size_t initialSize,size_t expansionSize=0){
-        size=initialSize;
         sizeStep=expansionSize;
-        nodes = new QObjectPool<T>::Node[size];
-
-        for (size_t i = 0; i < size; ++i) {
-            nodes[i].next = i + 1;
-            nodes[i].id = i;
-            nodes[i].data=new T();
-        }
-
-        lastFreeNode = 0;
+        if(initialSize>0)
+            AddSlab(initialSize);
     };
     ~QObjectPool(){
         ClearAll();
     };
 
-    Node* nodes;
-    size_t size = 2;
+    size_t size = 0;
     size_t sizeStep = 0;
-    size_t freeSize = 2;
-    size_t lastFreeNode = 0;
+    //The index of the first node that has never been used since the last FreeAll() call.
+    size_t bumpIndex = 0;
+    //The head of the list of individually freed nodes.
+    int lastFreeNode = -1;
     
 
     Node & Create(){
-        //cout<<"pool size: "<<size<<" free node index: "<< lastFreeNode<<endl;
-        if (lastFreeNode==size ) {
+        if(lastFreeNode!=-1){
+            Node &node=*nodeTable[lastFreeNode];
+            lastFreeNode = node.next;
+            return node;
+        }
+        if (bumpIndex==size ) {
             if (sizeStep==0){
-                if(size==0){
-                    Resize(2);
-                }else{
-                    Resize(size * 2);
-                }
-                
+                AddSlab(size==0 ? 2:size);
             }else{
-                Resize(size+sizeStep);
+                AddSlab(sizeStep);
             }
-            
         }
 
-        size_t newNodeIndex=lastFreeNode;
-        lastFreeNode = nodes[lastFreeNode].next;
-
-        return nodes[newNodeIndex];
+        return *nodeTable[bumpIndex++];
     };
     void Free(int nodeID){
-        nodes[nodeID].next = lastFreeNode;
+        nodeTable[nodeID]->next = lastFreeNode;
         lastFreeNode = nodeID;
     };
     void FreeAll(){
-        for (size_t i = 0; i < size; i++) {
-            nodes[i].next = i + 1;
-        }
-
-        lastFreeNode = 0;
+        bumpIndex = 0;
+        lastFreeNode = -1;
     };
     void ClearAll(){
-        if(size>0){
-            for (int i=0;i<size;++i){
-                //cout<<"pool object deleted index:"<<i<<endl;
-                delete nodes[i].data;
-                nodes[i].data=nullptr;
-            }
-            delete[] nodes;
-            size=0;
-            lastFreeNode=0;
+        for (size_t i=0;i<slabs.size();++i){
+            delete[] slabs[i].objects;
+            delete[] slabs[i].nodes;
         }
-        
+        slabs.clear();
+        nodeTable.clear();
+        size=0;
+        bumpIndex=0;
+        lastFreeNode=-1;
+    };
+
+    /** Returns a pool instance that is owned by the calling thread. It's useful to create objects from multiple threads without any locking. 
+     */
+    static QObjectPool<T> &GetThreadLocalPool(){
+        thread_local QObjectPool<T> pool(100,50);
+        return pool;
     };
 
     
@@ -170,5 +155,3 @@ public:
 
 
 #endif // QOBJECTPOOL_H
-
-
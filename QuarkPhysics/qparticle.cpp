@@ -32,14 +32,14 @@
 
 void QParticle::ClearOneTimeCollisions()
 {
-	oneTimeCollidedBodies.clear();
-	previousCollidedBodies.clear();
+	oneTimeCollidedBodies.Clear();
+	previousCollidedBodies.Clear();
 }
 
 void QParticle::ResetOneTimeCollisions()
 {
-	oneTimeCollidedBodies=previousCollidedBodies;
-	previousCollidedBodies.clear();
+	oneTimeCollidedBodies.Swap(previousCollidedBodies);
+	previousCollidedBodies.Clear();
 }
 
 void QParticle::UpdateAABB()
@@ -80,10 +80,10 @@ QParticle *QParticle::SetGlobalPosition(QVector value){
 	if(ownerMesh==nullptr){
 		this->position=this->globalPosition;
 	}else{
+		ownerMesh->subConvexPolygonCachesNeedsUpdate=true;
+		ownerMesh->polygonSegmentBVHNeedsUpdate=true;
 		QBody* ownerBody=ownerMesh->GetOwnerBody();
 		if(ownerBody!=nullptr){
-			ownerBody->inertiaNeedsUpdate=true;
-			ownerBody->circumferenceNeedsUpdate=true;
 			if (ownerBody->GetBodyType()==QBody::BodyTypes::SOFT){
 				//ownerBody->WakeUp();
 				//ownerMesh->subConvexPolygonsNeedsUpdate=true;
@@ -119,6 +119,8 @@ QParticle *QParticle::SetPosition(QVector value){
 			}
 			ownerMesh->subConvexPolygonsNeedsUpdate=true;
 		}
+		ownerMesh->shapeMatchingRestPositionsNeedsUpdate=true;
+		ownerMesh->localBoundsNeedsUpdate=true;
 	}
 	return this;
 }
@@ -139,6 +141,7 @@ QParticle *QParticle::SetOwnerMesh(QMesh *mesh){
 QParticle *QParticle::SetRadius(float radius){
 	r=radius;
 	if(ownerMesh!=nullptr){
+		ownerMesh->localBoundsNeedsUpdate=true;
 		QBody* ownerBody=ownerMesh->GetOwnerBody();
 		if(ownerBody!=nullptr){
 			ownerBody->inertiaNeedsUpdate=true;
@@ -188,33 +191,35 @@ QParticle *QParticle::AddForce(QVector value){
 
 QParticle *QParticle::AddAccumulatedForce(QVector value)
 {
-	accumulatedForces.push_back(value);
+	accumulatedForce+=value;
+	++accumulatedForceCount;
     return this;
 }
 
 QParticle *QParticle::ClearAccumulatedForces()
 {
-	accumulatedForces.clear();
+	accumulatedForce=QVector::Zero();
+	accumulatedForceCount=0;
     return this;
 }
 
 QParticle *QParticle::ApplyAccumulatedForces()
 {
-	if(accumulatedForces.size()>0 ){
-		QVector accumulatedForce=QVector::Zero();
-		for(size_t j=0;j<accumulatedForces.size();++j ){
-			accumulatedForce+=accumulatedForces[j];
-		}
-		accumulatedForce/=accumulatedForces.size();
-		ApplyForce(accumulatedForce);
-		accumulatedForces.clear();
+	if(accumulatedForceCount>0 ){
+		ApplyForce(accumulatedForce/accumulatedForceCount);
+		ClearAccumulatedForces();
 	}
     return this;
 }
 
 bool QParticle::IsConnectedWithSpring(QParticle *particle)
 {
-    return springConnectedParticles.find(particle) != springConnectedParticles.end();
+	if(ownerMesh!=nullptr && ownerMesh->CheckSpringAdjacency(this,particle) )
+		return true;
+	//The spring may be in the mesh of the other particle
+	if(particle!=nullptr && particle->ownerMesh!=nullptr && particle->ownerMesh!=ownerMesh)
+		return particle->ownerMesh->CheckSpringAdjacency(particle,this);
+	return false;
 }
 
 void QParticle::ApplyForceToParticleSegment(QParticle *pA, QParticle *pB,QVector force, QVector fromPosition)
@@ -238,5 +243,13 @@ void QParticle::ApplyForceToParticleSegment(QParticle *pA, QParticle *pB,QVector
 
 	pA->globalPosition+=rateA*force;
 	pB->globalPosition+=rateB*force;
+	if(pA->ownerMesh!=nullptr){
+		pA->ownerMesh->subConvexPolygonCachesNeedsUpdate=true;
+		pA->ownerMesh->polygonSegmentBVHNeedsUpdate=true;
+	}
+	if(pB->ownerMesh!=nullptr){
+		pB->ownerMesh->subConvexPolygonCachesNeedsUpdate=true;
+		pB->ownerMesh->polygonSegmentBVHNeedsUpdate=true;
+	}
 }
 
@@ -29,7 +29,6 @@
 #define QPARTICLE_H
 #include "qvector.h"
 #include <vector>
-#include <unordered_set>
 #include "qaabb.h"
 
 class QBody;
@@ -53,7 +52,8 @@ class QParticle
 
 	QVector force=QVector::Zero();
 
-	std::vector<QVector> accumulatedForces;
+	QVector accumulatedForce=QVector::Zero();
+	int accumulatedForceCount=0;
 
 	bool enabled=true;
 
@@ -66,10 +66,78 @@ class QParticle
 	void ClearOneTimeCollisions();
 
 protected:
-	std::unordered_set<QParticle*> springConnectedParticles;
+	//A small set of bodies with an inline storage. The lazy particles rarely collide with more than a few bodies in a step, so the bodies beyond the inline capacity are kept in a heap vector that is allocated when it's needed.
+	struct BodySet{
+		static const int INLINE_CAPACITY=2;
+		QBody *inlineBodies[INLINE_CAPACITY];
+		int count=0;
+		std::vector<QBody*> *overflowBodies=nullptr;
+
+		BodySet(){}
+		BodySet(const BodySet &other){
+			*this=other;
+		}
+		~BodySet(){
+			delete overflowBodies;
+		}
+		BodySet &operator=(const BodySet &other){
+			if(this==&other)
+				return *this;
+			Clear();
+			for(int i=0;i<other.count;++i){
+				Insert(i<INLINE_CAPACITY ? other.inlineBodies[i]:(*other.overflowBodies)[i-INLINE_CAPACITY]);
+			}
+			return *this;
+		}
+		bool Contains(QBody *body) const{
+			int inlineCount=count<INLINE_CAPACITY ? count:INLINE_CAPACITY;
+			for(int i=0;i<inlineCount;++i){
+				if(inlineBodies[i]==body)
+					return true;
+			}
+			for(int i=INLINE_CAPACITY;i<count;++i){
+				if((*overflowBodies)[i-INLINE_CAPACITY]==body)
+					return true;
+			}
+			return false;
+		}
+		void Insert(QBody *body){
+			if(Contains(body) )
+				return;
+			if(count<INLINE_CAPACITY){
+				inlineBodies[count]=body;
+			}else{
+				if(overflowBodies==nullptr)
+					overflowBodies=new std::vector<QBody*>();
+				overflowBodies->push_back(body);
+			}
+			++count;
+		}
+		void Clear(){
+			count=0;
+			if(overflowBodies!=nullptr)
+				overflowBodies->clear();
+		}
+		void Swap(BodySet &other){
+			for(int i=0;i<INLINE_CAPACITY;++i){
+				QBody *body=inlineBodies[i];
+				inlineBodies[i]=other.inlineBodies[i];
+				other.inlineBodies[i]=body;
+			}
+			int otherCount=other.count;
+			other.count=count;
+			count=otherCount;
+			std::vector<QBody*> *otherOverflowBodies=other.overflowBodies;
+			other.overflowBodies=overflowBodies;
+			overflowBodies=otherOverflowBodies;
+		}
+	};
+
+	BodySet oneTimeCollidedBodies; 
+	BodySet previousCollidedBodies;
 
-	unordered_set<QBody*> oneTimeCollidedBodies; 
-	unordered_set<QBody*> previousCollidedBodies;
+	//The row of the particle in the spring adjacency of its mesh
+	int springAdjacencyRow=-1;
 
 	void ResetOneTimeCollisions();
 
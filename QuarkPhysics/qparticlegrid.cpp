@@ -0,0 +1,127 @@
+
+/************************************************************************************
+ * MIT License
+ *
+ * Copyright (c) 2023 Eray Zesen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * https://github.com/erayzesen/QuarkPhysics
+ *
+**************************************************************************************/
+#include "qparticlegrid.h"
+#include "qparticle.h"
+#include <cmath>
+
+void QParticleGrid::Clear()
+{
+	entries.clear();
+	entryPositions.clear();
+}
+
+int QParticleGrid::Insert(QParticle *particle)
+{
+	Entry entry;
+	entry.particle=particle;
+	entry.order=entries.size();
+	entries.push_back(entry);
+	entryPositions.push_back(particle->GetGlobalPosition() );
+	return entry.order;
+}
+
+void QParticleGrid::Build(float interactionDistance)
+{
+	cellSize=interactionDistance>0.0f ? interactionDistance : 1.0f;
+	cellSizeFactor=1.0f/cellSize;
+	Sort();
+}
+
+void QParticleGrid::Refit()
+{
+	for(size_t i=0;i<entries.size();++i){
+		entryPositions[i]=entries[i].particle->GetGlobalPosition();
+	}
+	Sort();
+}
+
+void QParticleGrid::Sort()
+{
+	//The bucket count is a power of two and about twice the particle count.
+	int particleCount=entries.size();
+	tableWidth=4;
+	tableHeight=4;
+	while(tableWidth*tableHeight<particleCount*2){
+		if(tableWidth==tableHeight)
+			tableWidth*=2;
+		else
+			tableHeight*=2;
+	}
+	int bucketCount=tableWidth*tableHeight;
+
+	bucketStarts.assign(bucketCount+1,0);
+	entryCellsX.resize(particleCount);
+	entryCellsY.resize(particleCount);
+	sortedEntries.resize(particleCount);
+
+	//Counting sort
+	for(int i=0;i<particleCount;++i){
+		QVector pos=entryPositions[i];
+		int cellX=(int)floor(pos.x*cellSizeFactor);
+		int cellY=(int)floor(pos.y*cellSizeFactor);
+		entryCellsX[i]=cellX;
+		entryCellsY[i]=cellY;
+		bucketStarts[GetBucket(cellX,cellY)+1]+=1;
+	}
+	for(int i=0;i<bucketCount;++i){
+		bucketStarts[i+1]+=bucketStarts[i];
+	}
+	//Particles are placed to the ends of their buckets in reverse order, so each bucket keeps the insertion order.
+	for(int i=particleCount-1;i>=0;--i){
+		int bucket=GetBucket(entryCellsX[i],entryCellsY[i]);
+		sortedEntries[--bucketStarts[bucket+1]]=entries[i];
+	}
+	//After the placement, the end of each bucket points to its start. Shifting them gives the bucket ranges.
+	for(int i=0;i<bucketCount;++i){
+		bucketStarts[i]=bucketStarts[i+1];
+	}
+	bucketStarts[bucketCount]=particleCount;
+}
+
+int QParticleGrid::GetNeighborRanges(int order, int ranges[])
+{
+	int cellX=entryCellsX[order];
+	int cellY=entryCellsY[order];
+	int firstColumn=(cellX-1) & (tableWidth-1);
+	int rangeCount=0;
+	for(int y=cellY-1;y<=cellY+1;++y){
+		int rowStart=(y & (tableHeight-1))*tableWidth;
+		if(firstColumn+3<=tableWidth){
+			ranges[rangeCount*2]=bucketStarts[rowStart+firstColumn];
+			ranges[rangeCount*2+1]=bucketStarts[rowStart+firstColumn+3];
+			rangeCount+=1;
+		}else{
+			//The columns are wrapped to the start of the row.
+			ranges[rangeCount*2]=bucketStarts[rowStart+firstColumn];
+			ranges[rangeCount*2+1]=bucketStarts[rowStart+tableWidth];
+			ranges[rangeCount*2+2]=bucketStarts[rowStart];
+			ranges[rangeCount*2+3]=bucketStarts[rowStart+firstColumn+3-tableWidth];
+			rangeCount+=2;
+		}
+	}
+	return rangeCount;
+}
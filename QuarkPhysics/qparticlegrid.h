@@ -0,0 +1,105 @@
+
+/************************************************************************************
+ * MIT License
+ *
+ * Copyright (c) 2023 Eray Zesen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * https://github.com/erayzesen/QuarkPhysics
+ *
+**************************************************************************************/
+#ifndef QPARTICLEGRID_H
+#define QPARTICLEGRID_H
+#include <vector>
+#include "qvector.h"
+
+using namespace std;
+
+class QParticle;
+
+/** @brief QParticleGrid is a uniform hash grid of particles. The world rebuilds it once per iteration with a counting sort, and the particle collision tests query only the neighbor cells of a particle. The cell size is the largest interaction distance of the inserted particles, so colliding particles are always in the neighbor cells of each other.
+ * The cells are wrapped to a power of two sized table. Since the table is at least 4x4, the 3x3 neighbor cells never share a bucket, and the neighbor cells of a row are consecutive ranges of the sorted particles.
+ */
+class QParticleGrid
+{
+public:
+	/** @brief A particle record of the grid. The order is the insertion index of the particle, it's used to test every particle pair only once. */
+	struct Entry{
+		QParticle *particle=nullptr;
+		int order=0;
+	};
+protected:
+	float cellSize=1.0f;
+	float cellSizeFactor=1.0f;
+	int tableWidth=4;
+	int tableHeight=4;
+
+	vector<Entry> entries;
+	vector<QVector> entryPositions;
+	vector<int> entryCellsX;
+	vector<int> entryCellsY;
+	vector<Entry> sortedEntries;
+	vector<int> bucketStarts;
+
+	int GetBucket(int cellX,int cellY){
+		return (cellX & (tableWidth-1))+(cellY & (tableHeight-1))*tableWidth;
+	}
+	//Sorts the entries into their cells with the current cell size.
+	void Sort();
+public:
+	QParticleGrid(){};
+
+	/** Removes all particles from the grid. The allocated memory is kept for the next build. */
+	void Clear();
+	/** Adds a particle to the grid. The grid has to be built again to query the particle. 
+	 * @param particle A particle to add.
+	 * @return Returns the order of the particle in the grid.
+	 */
+	int Insert(QParticle *particle);
+	/** Sorts the particles into their cells with a counting sort. 
+	 * @param interactionDistance The maximum distance between the centers of two particles that can collide. It's used as the cell size.
+	 */
+	void Build(float interactionDistance);
+	/** Sorts the particles into their cells again with their current positions. The cell size and the orders of the particles don't change. It's used when the particles are moved after the build.
+	 */
+	void Refit();
+
+	/** Returns the particle count of the grid. */
+	int GetParticleCount(){
+		return entries.size();
+	}
+	/** Returns the cell size of the grid. */
+	float GetCellSize(){
+		return cellSize;
+	}
+
+	/** Finds the ranges of the sorted particles in the 3x3 cells around a particle of the grid. The cell of the particle at the build time is used, so the neighborhood of two particles is always symmetric. 
+	 * @param order The order of the particle in the grid.
+	 * @param ranges An output array with at least 12 elements. The begin and end indexes of each range are written in pairs.
+	 * @return Returns the count of the ranges.
+	 */
+	int GetNeighborRanges(int order,int ranges[]);
+	/** Returns the sorted particles of the grid. */
+	Entry *GetSortedEntries(){
+		return sortedEntries.data();
+	}
+
+};
+
+#endif // QPARTICLEGRID_H
@@ -234,7 +234,19 @@ void QRaycast::RaycastToPolygon(QBody *body, QMesh *mesh, QVector rayPosition, Q
 
 
 	
-	for(int i=0;i<mesh->polygon.size();i++){
+	//Long polygons only test the segments overlapping with the bounding box of the ray.
+	static thread_local vector<int> candidateSegments;
+	bool useSegmentBVH=mesh->polygon.size()>=16;
+	int candidateCount=mesh->polygon.size();
+	if(useSegmentBVH){
+		QAABB rayAABB(QVector(min(rayStart.x,rayEnd.x),min(rayStart.y,rayEnd.y)),QVector(max(rayStart.x,rayEnd.x),max(rayStart.y,rayEnd.y)) );
+		candidateSegments.clear();
+		mesh->GetPolygonSegmentsInAABB(rayAABB,candidateSegments);
+		candidateCount=candidateSegments.size();
+	}
+	
+	for(int c=0;c<candidateCount;c++){
+		int i=useSegmentBVH ? candidateSegments[c] : c;
 
 		QParticle *p=mesh->polygon[i];
 		QParticle *np=mesh->polygon[(i+1)%mesh->polygon.size() ];
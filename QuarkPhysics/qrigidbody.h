@@ -40,6 +40,7 @@ class QRigidBody : public QBody
 {
 	bool fixedRotation=false;
 	QVector force=QVector::Zero();
+	friend class QWorld;
 protected:
 	float angularForce=0.0f;
 public:
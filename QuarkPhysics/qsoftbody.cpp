@@ -184,6 +184,14 @@ void QSoftBody::PostUpdate()
 }
 
 
+QVector QSoftBody::GetPolygonChordNormal(vector<QParticle *> &polygon, int index)
+{
+	int polygonSize=polygon.size();
+	QParticle *pp=polygon[index==0 ? polygonSize-1 : index-1];
+	QParticle *np=polygon[index==polygonSize-1 ? 0 : index+1];
+	return (np->GetGlobalPosition()-pp->GetGlobalPosition()).Perpendicular().Normalized();
+}
+
 void QSoftBody::PreserveAreas()
 {
 
@@ -201,13 +209,26 @@ void QSoftBody::PreserveAreas()
 
 	
 
+	//The circumference is calculated with the local positions, so it's cached by the body
+	float circumference=max (GetCircumference(),0.001f);
+
 	for(auto mesh:_meshes){
 
 		if(mesh->GetSpringCount()==0)continue;
 
-		 
+		vector<QParticle*> &polygon=mesh->polygon;
+		int polygonSize=polygon.size();
+		if(polygonSize<3)
+			continue;
 		
-		float currentMeshesArea=mesh->GetPolygonArea(mesh->polygon,false);
+		//The area of the polygon with the global positions, it's the same as QMesh::GetPolygonArea() 
+		float currentMeshesArea=0.0f;
+		QVector prevPos=polygon[polygonSize-1]->GetGlobalPosition();
+		for(int n=0;n<polygonSize;n++){
+			QVector pos=polygon[n]->GetGlobalPosition();
+			currentMeshesArea-=(prevPos.y+pos.y)*(pos.x-prevPos.x)*0.5f;
+			prevPos=pos;
+		}
 
 		if(currentMeshesArea<-targetPreservationArea*5){
 			currentMeshesArea=-targetPreservationArea*5;
@@ -215,7 +236,6 @@ void QSoftBody::PreserveAreas()
 		if(currentMeshesArea>targetPreservationArea*5){
 			currentMeshesArea=targetPreservationArea*5;
 		}
-		float circumference=max (GetCircumference(),0.001f);
 
 		float deltaArea=(targetPreservationArea*areaPreservingRate)-currentMeshesArea;
 		
@@ -228,49 +248,49 @@ void QSoftBody::PreserveAreas()
 		}
 		
 		if (deltaArea==0.0f){
-			return;
+			continue;
 		}
 
-		//For checking normals to the particle to polygon center vector
-
 		float pressure=(deltaArea/circumference)*areaPreservingRigidity;
 
-		
-		vector<QVector> volumeForces;
-		QVector centerOfMesh=QMesh::GetAveragePositionAndRotation(mesh->polygon).first;
-		for(int n=0;n<mesh->polygon.size();n++){
-			QParticle *pp=mesh->polygon[ (n-1+mesh->polygon.size())%mesh->polygon.size() ];
-			QParticle *np=mesh->polygon[ (n+1)%mesh->polygon.size() ];
-			QVector vec=np->GetGlobalPosition()-pp->GetGlobalPosition();
-			
-			
-			QVector normal=vec.Perpendicular().Normalized();
-
-			//Checking Normal
-			/* QVector sideCenter=(pp->GetGlobalPosition()+np->GetGlobalPosition())*0.5f;
-			QVector toCenterUnit=(sideCenter-centerOfMesh).Normalized();
-			if(normal.Dot(toCenterUnit)<0.0f ){
-				normal=QVector::Zero();
-			} */
-			
-			volumeForces.push_back(pressure*(normal)*ts);
-		}
+		//The pressure force of the particle n is along the normal of the chord between its neighbors and it's shared by the neighbors equally. So each particle gets the half of the forces of the chords on its both sides.
+		float forceFactor=pressure*ts*0.5f;
+
+		//The chord normals which need the first positions are calculated before the particles are moved
+		QVector firstNormal=GetPolygonChordNormal(polygon,0);
+		QVector secondNormal=GetPolygonChordNormal(polygon,1);
+		QVector lastNormal=GetPolygonChordNormal(polygon,polygonSize-1);
+
+		QVector prevNormal=lastNormal;
+		QVector currentNormal=firstNormal;
+		for(int n=0;n<polygonSize;n++){
+			int next=n+1==polygonSize ? 0 : n+1;
+			QVector nextNormal;
+			if(next==0){
+				nextNormal=firstNormal;
+			}else if(next==1){
+				nextNormal=secondNormal;
+			}else if(next==polygonSize-1){
+				nextNormal=lastNormal;
+			}else{
+				nextNormal=GetPolygonChordNormal(polygon,next);
+			}
 
-		for(int n=0;n<mesh->polygon.size();n++){
-			QParticle *pp=mesh->polygon[ (n-1+mesh->polygon.size())%mesh->polygon.size() ];
-			QParticle *np=mesh->polygon[ (n+1)%mesh->polygon.size() ];
-			if (pp->GetEnabled()==false || np->GetEnabled()==false )
-				continue;
-			QVector centerPos=(np->GetGlobalPosition()+pp->GetGlobalPosition())*0.5f;
-			QParticle::ApplyForceToParticleSegment(pp,np,volumeForces[n],centerPos);
-			//GetWorld()->GetGizmos()->push_back( new QGizmoLine( centerPos,centerPos+volumeForces[n]*30,true ) );
+			QParticle *particle=polygon[n];
+			if(particle->GetEnabled()){
+				QVector force=QVector::Zero();
+				if(polygon[(n-2+polygonSize)%polygonSize]->GetEnabled() )
+					force+=prevNormal;
+				if(polygon[(n+2)%polygonSize]->GetEnabled() )
+					force+=nextNormal;
+				particle->ApplyForce(force*forceFactor);
+			}
 
+			prevNormal=currentNormal;
+			currentNormal=nextNormal;
 		}
-		
-
 
 	}
-
 }
 
 
@@ -290,49 +310,68 @@ void QSoftBody::ApplyShapeMatching()
 		}
 	}
 
+	//The target rotation as a unit vector, it's calculated once for the fixed transform
+	QVector fixedRotationUnit=QVector::AngleToUnitVector(shapeMatchingFixedRotation);
+	float forceFactor=0.02f*(1+rigidity)*shapeMatchingRate*ts;
+
 	for(int i=0;i<_meshes.size();i++){
 		QMesh *mesh=_meshes[i];
 		if(mesh->GetParticleCount()<2)
 			continue;
 
-		vector<QParticle*> particles;
-		if(mesh->GetCollisionBehavior()==QMesh::CollisionBehaviors::POLYLINE ){
-			particles=mesh->polygon;
-		}else{
-			particles=mesh->particles;
+		vector<QParticle*> &particles=mesh->GetShapeMatchingParticles();
+		if(particles.empty() )
+			continue;
+		if(mesh->shapeMatchingRestPositionsNeedsUpdate || mesh->shapeMatchingRestPositions.size()!=particles.size() || mesh->shapeMatchingRestPositionsOfPolygon!=(&particles==&mesh->polygon) ){
+			mesh->UpdateShapeMatchingRestPositions();
 		}
+		const vector<QVector> &restPositions=mesh->shapeMatchingRestPositions;
+		int particleCount=particles.size();
 
 		
 		QVector averagePosition;
-		float averageRotation;
+		QVector rotationUnit;
 		if(enableShapeMatchingFixedTransform){
 			averagePosition=shapeMatchingFixedPosition;
-			averageRotation=shapeMatchingFixedRotation;
+			rotationUnit=fixedRotationUnit;
 		}else{
-			auto averagePositionAndRotation=QMesh::GetAveragePositionAndRotation(particles);
-			averagePosition=averagePositionAndRotation.first;
-			averageRotation=averagePositionAndRotation.second;
-
+			averagePosition=QVector::Zero();
+			for(int n=0;n<particleCount;n++){
+				averagePosition+=particles[n]->GetGlobalPosition();
+			}
+			averagePosition/=particleCount;
+
+			//The best fit rotation is the rotation part of the polar decomposition of the 2x2 covariance matrix of the current and rest positions. In 2D, it's the normalized sum of the dot and the cross products, so no trigonometric function is needed.
+			float cosAxis=0.0f;
+			float sinAxis=0.0f;
+			for(int n=0;n<particleCount;n++){
+				QVector currentVec=particles[n]->GetGlobalPosition()-averagePosition;
+				const QVector &restVec=restPositions[n];
+				cosAxis+=currentVec.x*restVec.x+currentVec.y*restVec.y;
+				sinAxis+=currentVec.x*restVec.y-currentVec.y*restVec.x;
+			}
+			float axisLength=sqrt(cosAxis*cosAxis+sinAxis*sinAxis);
+			if(axisLength>0.0f){
+				rotationUnit=QVector(cosAxis/axisLength,sinAxis/axisLength);
+			}else{
+				rotationUnit=QVector(1.0f,0.0f);
+			}
 		}
 
-		vector<QVector> matchingPositions=QMesh::GetMatchingParticlePositions(particles,averagePosition,averageRotation);	
-
-		
-		for(int n=0;n<particles.size();n++){
+		for(int n=0;n<particleCount;n++){
 			QParticle * particle=particles[n];
 
 			if (particle->GetEnabled()==false )
 				continue;
 			
-			QVector targetPos=matchingPositions[n];
-			//world->GetGizmos()->push_back(new QGizmoCircle(targetPos,3.0f) );
+			const QVector &restVec=restPositions[n];
+			QVector targetPos=averagePosition+QVector(restVec.x*rotationUnit.x+restVec.y*rotationUnit.y, restVec.y*rotationUnit.x-restVec.x*rotationUnit.y);
+			//world->GetGizmos()->AddCircle(targetPos,3.0f);
 			QVector distance=targetPos-particle->GetGlobalPosition();
-			QVector distanceUnit=distance.Normalized();
 
+			//min(distance^2*factor,distance) along the unit vector of the distance
 			float distanceLen=distance.Length();
-			float forceLinear=min(distanceLen*distanceLen*(0.02f*(1+rigidity))*shapeMatchingRate*ts,distanceLen*ts);
-			QVector force=forceLinear*distanceUnit;
-			particle->ApplyForce(force);
+			particle->ApplyForce(distance*min(distanceLen*forceFactor,ts) );
 		}
 
 	}
@@ -35,6 +35,7 @@ class QSoftBody : public QBody
 {
 	//#Softbody Properties
 	float rigidity=1.0f;
+	float compliance=0.0f;
 	float enableAreaPreserving=false;
 	float areaPreservingRate=0.8f;
 	float areaPreservingRigidity=1.0f;
@@ -62,6 +63,9 @@ class QSoftBody : public QBody
 
 	//Helper methods
 
+	//Returns the unit normal of the chord between the neighbors of the polygon particle at the index
+	static QVector GetPolygonChordNormal(vector<QParticle*> &polygon,int index);
+
 	float safe_asin(float value){
 		if(value<-1.0f){
 			return asin(-1.0);
@@ -89,6 +93,14 @@ public:
 		rigidity=value;
 		return this;
 	};
+	/** Sets the compliance of the body. It determines the compliance of the spring joints of the body when the world uses the XPBD constraint solver. Unlike the rigidity, it doesn't depend on the iteration count and the time step.
+	 * @param value A value to set. It's the inverse of the stiffness, 0.0 means infinitely stiff springs.
+	 *  @return A pointer to the body itself.
+	 */
+	QSoftBody * SetCompliance(float value){
+		compliance=value;
+		return this;
+	};
 	/** Sets the rate to apply area preserving to the body if the area preserving is enabled. Determines the rate of the target area to apply preserve constraints.  
 	 * @param value A value to set, it must be a value between 0.0 and 1.0. 
 	 *  @return A pointer to the body itself.
@@ -229,6 +241,10 @@ public:
 	float  GetRigidity(){
 		return rigidity;
 	};
+	/** Returns the compliance of the body. It determines the compliance of the spring joints of the body when the world uses the XPBD constraint solver. */ 
+	float  GetCompliance(){
+		return compliance;
+	};
 	/** Returns the rate to apply area preserving to the body if the area preserving is enabled. Determines the rate of the target area to apply preserve constraints. */ 
 	float  GetAreaPreservingRate(){
 		return areaPreservingRate;
@@ -59,57 +59,9 @@ void QSpring::Update(float rigidity,bool internalsException, bool isWorldSpring)
 	}
 	bool particleACanGetResponse=true;
 	bool particleBCanGetResponse=true;
-
-	//Check body modes and simulation models 
-	if(isWorldSpring==true){
-		if(pA->GetOwnerMesh()!=nullptr ){
-			QBody *bA=pA->GetOwnerMesh()->GetOwnerBody();
-			if(bA!=nullptr){
-				if( bA->GetSimulationModel()==QBody::SimulationModels::RIGID_BODY ||  bA->GetMode()==QBody::Modes::STATIC ){
-					particleACanGetResponse=false;
-				}
-			}
-		}
-		
-
-		if(pB->GetOwnerMesh()!=nullptr ){
-			QBody *bB=pB->GetOwnerMesh()->GetOwnerBody();
-			if(bB!=nullptr){
-				if( bB->GetSimulationModel()==QBody::SimulationModels::RIGID_BODY ||  bB->GetMode()==QBody::Modes::STATIC ){
-					particleBCanGetResponse=false;
-				}
-			}
-		}
-
-		if (pB->GetEnabled()==false ){
-			particleBCanGetResponse=false;
-		}
-
-	}
-
-	if (pA->GetEnabled()==false ){
-		particleACanGetResponse=false;
-	}
-
-	if (pB->GetEnabled()==false ){
-		particleBCanGetResponse=false;
-	}
-
-	if (particleACanGetResponse==false && particleBCanGetResponse==false ){
+	if(CheckParticleResponses(isWorldSpring,particleACanGetResponse,particleBCanGetResponse)==false){
 		return;
 	}
-
-
-
-	
-	
-	if(pA->GetOwnerMesh()!=nullptr && pB->GetOwnerMesh()!=nullptr){
-		if(pA->GetOwnerMesh()->GetOwnerBody()!=nullptr && pB->GetOwnerMesh()->GetOwnerBody()!=nullptr){
-			if (pA->GetOwnerMesh()->GetOwnerBody()->GetIsSleeping() && pB->GetOwnerMesh()->GetOwnerBody()->GetIsSleeping() ){
-				return;
-			}
-		}
-	}
 	QVector sv=pB->GetGlobalPosition()-pA->GetGlobalPosition(); //spring vec
 	float sl=sv.Length(); //spring distance
 	QVector svu=sv.Normalized(); //spring vector unit
@@ -165,8 +117,110 @@ void QSpring::Update(float rigidity,bool internalsException, bool isWorldSpring)
 
 }
 
+void QSpring::UpdateWithCompliance(float compliance, float timeStep, bool internalsException, bool isWorldSpring)
+{
+	if(enabled==false)
+		return;
+	if(timeStep==0.0f)
+		return;
+
+	if( pA==nullptr || pB==nullptr){
+		return;
+	}
+
+	//Internal springs of the volume preserving bodies are passivated as usual
+	if(internalsException && isInternal ){
+		Update(1.0f,internalsException,isWorldSpring);
+		return;
+	}
+
+	bool particleACanGetResponse=true;
+	bool particleBCanGetResponse=true;
+	if(CheckParticleResponses(isWorldSpring,particleACanGetResponse,particleBCanGetResponse)==false){
+		return;
+	}
+
+	//Inverse masses, particles that can't get response behave like infinite mass
+	float wA=particleACanGetResponse && pA->GetMass()>0.0f ? 1.0f/pA->GetMass() : 0.0f;
+	float wB=particleBCanGetResponse && pB->GetMass()>0.0f ? 1.0f/pB->GetMass() : 0.0f;
+	if(wA+wB==0.0f)
+		return;
+
+	QVector sv=pB->GetGlobalPosition()-pA->GetGlobalPosition(); //spring vec
+	float sl=sv.Length(); //spring distance
+	if(sl==0.0f)
+		return;
+	QVector svu=sv/sl; //spring vector unit
+
+	if (enableDistanceLimit){
+		float lengthRate=sl/length;
+		if( lengthRate>maximumDistanceFactor || lengthRate<minimumDistanceFactor ){
+			compliance=0.0f;
+		} 
+	}
+
+	float c=sl-length;
+	float alpha=compliance/(timeStep*timeStep);
+	float deltaLambda=(-c-alpha*lambda)/(wA+wB+alpha);
+	lambda+=deltaLambda;
+
+	if(particleACanGetResponse){
+		pA->ApplyForce(-svu*(wA*deltaLambda) );
+	}
+	if(particleBCanGetResponse){
+		pB->ApplyForce(svu*(wB*deltaLambda) );
+	}
+
+}
+
+bool QSpring::CheckParticleResponses(bool isWorldSpring, bool &particleACanGetResponse, bool &particleBCanGetResponse)
+{
 
+	//Check body modes and simulation models 
+	if(isWorldSpring==true){
+		if(pA->GetOwnerMesh()!=nullptr ){
+			QBody *bA=pA->GetOwnerMesh()->GetOwnerBody();
+			if(bA!=nullptr){
+				if( bA->GetSimulationModel()==QBody::SimulationModels::RIGID_BODY ||  bA->GetMode()==QBody::Modes::STATIC ){
+					particleACanGetResponse=false;
+				}
+			}
+		}
+		
 
+		if(pB->GetOwnerMesh()!=nullptr ){
+			QBody *bB=pB->GetOwnerMesh()->GetOwnerBody();
+			if(bB!=nullptr){
+				if( bB->GetSimulationModel()==QBody::SimulationModels::RIGID_BODY ||  bB->GetMode()==QBody::Modes::STATIC ){
+					particleBCanGetResponse=false;
+				}
+			}
+		}
+
+		if (pB->GetEnabled()==false ){
+			particleBCanGetResponse=false;
+		}
+
+	}
+
+	if (pA->GetEnabled()==false ){
+		particleACanGetResponse=false;
+	}
 
+	if (pB->GetEnabled()==false ){
+		particleBCanGetResponse=false;
+	}
 
+	if (particleACanGetResponse==false && particleBCanGetResponse==false ){
+		return false;
+	}
 
+	if(pA->GetOwnerMesh()!=nullptr && pB->GetOwnerMesh()!=nullptr){
+		if(pA->GetOwnerMesh()->GetOwnerBody()!=nullptr && pB->GetOwnerMesh()->GetOwnerBody()!=nullptr){
+			if (pA->GetOwnerMesh()->GetOwnerBody()->GetIsSleeping() && pB->GetOwnerMesh()->GetOwnerBody()->GetIsSleeping() ){
+				return false;
+			}
+		}
+	}
+	return true;
+}
@@ -46,6 +46,10 @@ class QSpring
 	float minimumDistanceFactor=0.25f;
 	float maximumDistanceFactor=4.0f;
 	bool enabled=true;
+	float compliance=0.0f;
+	float lambda=0.0f;
+
+	bool CheckParticleResponses(bool isWorldSpring,bool &particleACanGetResponse,bool &particleBCanGetResponse);
 public:
 	/**
 	 * Creates a spring between two particles. But auto calculates length with the distance between two particles.  
@@ -73,6 +77,20 @@ public:
 	 */
 	virtual void Update(float rigidity,bool internalsException,bool isWorldSpring=false);
 
+	/**
+	 * Applies spring constraints with the XPBD (extended position based dynamics) method and updates particle positions. Unlike the rigidity, the compliance is independent of the iteration count and the time step. The accumulated Lagrange multiplier of the spring must be reset with ResetLagrangeMultiplier() at the beginning of each step.
+	 * @param compliance The compliance of the constraint. It's the inverse of the stiffness, 0.0 means an infinitely stiff spring.
+	 * @param timeStep The time step of the simulation step.
+	 * @param internalsException It is usually set to false. However, if set to true, it pays attention to internal particle connections and applies the constraints accordingly. This setting is important for soft body objects with the volume preserving option enabled.
+	 * \Note This method is virtual and users can implement custom spring update methods in an interited class of QSpring. 
+	 */
+	virtual void UpdateWithCompliance(float compliance,float timeStep,bool internalsException,bool isWorldSpring=false);
+
+	/** Resets the accumulated Lagrange multiplier of the spring. The XPBD solver calls it at the beginning of each step. */
+	void ResetLagrangeMultiplier(){
+		lambda=0.0f;
+	}
+
 	//Get Methods
 	/** Returns particleA of the spring. */
 	QParticle *GetParticleA(){
@@ -94,6 +112,10 @@ public:
 	float GetRigidity(){
 		return rigidity;
 	}
+	/** Returns the compliance of the spring. It's used instead of the rigidity when the world uses the XPBD constraint solver. */
+	float GetCompliance(){
+		return compliance;
+	}
 
 	/** Returns whether the distance limit is enabled.
 	 *  If enabled, the spring applies full-strength constraints when the distance between particles
@@ -108,7 +130,7 @@ public:
 	}
 	/**  Returns the maximum distance factor to be enforced when the distance limits feature is enabled. */
 	float GetMaximumDistanceFactor(){
-		return minimumDistanceFactor;
+		return maximumDistanceFactor;
 	}
 
 	/** Returns whether the spring is enabled. */
@@ -159,6 +181,14 @@ public:
 		this->rigidity=rigidity;
 		return this;
 	}
+	/** Sets the compliance of the spring. It's used instead of the rigidity when the world uses the XPBD constraint solver.
+	 * @param value The compliance value to set. It's the inverse of the stiffness, 0.0 means an infinitely stiff spring.
+	 * @return A pointer to the spring itself.
+	 */
+	QSpring *SetCompliance(float value){
+		compliance=value;
+		return this;
+	}
 
 	/** Sets whether the distance limit is enabled.
 	 *  If enabled, the spring applies full-strength constraints when the distance between particles
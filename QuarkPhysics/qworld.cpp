@@ -32,6 +32,7 @@
 #include "qsoftbody.h"
 #include <algorithm>
 #include <array>
+#include <thread>
 #include <cmath>
 #include <iostream>
 #include <vector>
@@ -51,11 +52,7 @@ QWorld::~QWorld(){
 
 
 void QWorld::ClearGizmos(){
-	for(auto gizmo:gizmos){
-		delete gizmo;
-		gizmo=nullptr;
-	}
-	gizmos.clear();
+	gizmos.Clear();
 }
 
 // ## WORLD STEP
@@ -68,11 +65,21 @@ void QWorld::Update(){
 	ClearGizmos();
 
 
+	batchedRigidBodies.bodies.clear();
 	for(auto body:bodies){
 		if (body->GetEnabled()==false )
 			continue;
+		//The awake dynamic rigid bodies are gathered and integrated together after the loop
+		if(enableBatchedRigidBodyIntegration && body->GetBodyType()==QBody::BodyTypes::RIGID && body->GetMode()!=QBody::Modes::STATIC && body->GetIsSleeping()==false ){
+			body->QBody::Update();
+			batchedRigidBodies.bodies.push_back(static_cast<QRigidBody*>(body) );
+			continue;
+		}
 		body->Update();
 	}
+	if(batchedRigidBodies.bodies.size()>0){
+		IntegrateBatchedRigidBodies();
+	}
 
 	for(auto body:bodies){
 		if (body->GetEnabled()==false )
@@ -119,15 +126,42 @@ void QWorld::Update(){
 	
 	
 
-	for(unsigned int n=0;n<iteration;++n){
+	if(contactSolver==ContactSolvers::SEQUENTIAL_IMPULSE){
+		//The impulses of the last step are kept to warm start the solver.
+		previousContactImpulses.swap(contactImpulses);
+		contactImpulses.clear();
+	}
+
+	//The islands can be solved with more iterations than the world with their maximum iteration counts
+	int iterationCount=iteration;
+	if(enableAdaptiveIterations){
+		for(size_t i=0;i<bodies.size();++i){
+			QBody *body=bodies[i];
+			body->iterationIslandIndex=i;
+			body->iterationsConverged=body->GetMode()==QBody::Modes::STATIC;
+			body->iterationPenetration=-1.0f;
+			body->iterationConstraintError=-1.0f;
+			iterationCount=max(iterationCount,body->maximumIterationCount);
+		}
+	}
+
+	for(int n=0;n<iterationCount;++n){
 		QCollision::GetContactPool().FreeAll();
-		UpdateConstraints();
+		contactStream.clear();
+		UpdateConstraints(n==0);
 		for(auto body:bodies){
+			//The static bodies are marked as converged from the beginning, but they may be moved before the step
+			if(body->iterationsConverged && body->iterationMoved==false && n>0)
+				continue;
+			body->iterationMoved=false;
 			body->UpdateAABB();
 			for(auto mesh:body->_meshes) {
 				mesh->UpdatePolygonBisectors();
 			}
 		}
+		if(enableParticleGrid){
+			UpdateParticleGrid();
+		}
 
 
 
@@ -144,13 +178,7 @@ void QWorld::Update(){
 					QBody *bodyA=pair.first;
 					QBody *bodyB=pair.second;
 
-					vector<QCollision::Contact*> contacts=GetCollisions(bodyA,bodyB);
-
-						if(contacts.size()>0){
-							QManifold manifold(bodyA,bodyB);
-							manifold.contacts=contacts;
-							manifolds.push_back(manifold);
-						}
+					CreateManifold(bodyA,bodyB,manifolds);
 				}
 				
 				
@@ -174,12 +202,7 @@ void QWorld::Update(){
 						if(body->GetAABB().GetMax().x >= otherBody->GetAABB().GetMin().x){
 							if( body->GetAABB().GetMin().y <= otherBody->GetAABB().GetMax().y &&
 								body->GetAABB().GetMax().y >= otherBody->GetAABB().GetMin().y) {
-								vector<QCollision::Contact*> contacts=GetCollisions(body,otherBody);
-								if(contacts.size()>0){
-									QManifold manifold(body,otherBody);
-									manifold.contacts=contacts;
-									manifolds.push_back(manifold);
-								}
+								CreateManifold(body,otherBody,manifolds);
 
 
 							}
@@ -209,13 +232,7 @@ void QWorld::Update(){
 						continue;
 					}
 
-					vector<QCollision::Contact*> contacts=GetCollisions(bodyA,bodyB);
-					if(contacts.size()>0){
-						QManifold manifold(bodyA,bodyB);
-						manifold.contacts=contacts;
-						manifolds.push_back(manifold);
-
-					}
+					CreateManifold(bodyA,bodyB,manifolds);
 
 				}
 			}
@@ -224,46 +241,96 @@ void QWorld::Update(){
 
 
 
-		for(auto &manifold:manifolds){
-			manifold.Solve();
-		}
-		for(auto &manifold:manifolds){
-			manifold.SolveFrictionAndVelocities();
+		if(contactSolver==ContactSolvers::SEQUENTIAL_IMPULSE){
+			//The manifolds that the impulse solver can't solve are solved with the positional solver.
+			//The velocities are solved with the contacts of the first iteration, the next iterations only correct the positions with the new contacts.
+			impulseContactStream.clear();
+			for(auto &manifold:manifolds){
+				if(manifold.GetIsImpulseSolvable())
+					manifold.PrepareImpulses(&impulseContactStream,n==0);
+			}
+			if(n==0){
+				for(int v=0;v<iteration;++v){
+					for(auto &manifold:manifolds){
+						if(manifold.GetIsImpulseSolvable())
+							manifold.SolveImpulses();
+					}
+				}
+			}
+			for(auto &manifold:manifolds){
+				if(manifold.GetIsImpulseSolvable())
+					manifold.SolvePositionErrors();
+				else
+					manifold.Solve();
+			}
+			for(auto &manifold:manifolds){
+				if(manifold.GetIsImpulseSolvable()==false)
+					manifold.SolveFrictionAndVelocities();
+			}
+		}else{
+			for(auto &manifold:manifolds){
+				manifold.Solve();
+			}
+			for(auto &manifold:manifolds){
+				manifold.SolveFrictionAndVelocities();
+			}
 		}
 
-		
+
+		//The converged bodies can be pushed by the manifolds of the bodies which are still solved
+		if(enableAdaptiveIterations){
+			for(auto &manifold:manifolds){
+				QBody *manifoldBodies[2]={manifold.bodyA,manifold.bodyB};
+				for(int i=0;i<2;++i){
+					if(manifoldBodies[i]->iterationsConverged && manifoldBodies[i]->GetMode()!=QBody::Modes::STATIC)
+						manifoldBodies[i]->iterationMoved=true;
+				}
+			}
+		}
 
 		//The Self Collision Feature of Soft Bodies
+		//The manifolds have moved the particles since the grid was built, so it's refitted to their current positions.
+		if(particleGridIsReady && particleGridHasSelfCollisions){
+			particleGrid.Refit();
+		}
 		for(auto body:bodies){
+			if(body->iterationsConverged)
+				continue;
 			QAABB bodyAABB=body->GetAABB();
 			if(body->simulationModel!=QBody::SimulationModels::RIGID_BODY){
 				QSoftBody *sBody=static_cast<QSoftBody*>(body);
 				
 				if(sBody==nullptr)continue;
 				if(sBody->GetSelfCollisionsEnabled()==false)continue;
+				//With the particle grid, all particle pairs of the body are tested at once.
+				if(particleGridIsReady){
+					QCollision::CircleAndCircleSelf(sBody,particleGrid,contactStream,sBody->GetSelfCollisionsSpecifiedRadius());
+				}
 				for(int ma=0;ma<sBody->GetMeshCount();ma++){
 					QMesh *meshA=sBody->GetMeshAt(ma);
 					for(int mb=0;mb<sBody->GetMeshCount();mb++){
 						QMesh *meshB=sBody->GetMeshAt(mb);
-						vector<QCollision::Contact*> contacts;
+						//The self collision contacts are solved immediately, so they are removed from the contact stream after solving.
+						size_t contactsBegin=contactStream.size();
 						//Self Particle Collisions
-						if (meshA==meshB){
-							QCollision::CircleAndCircleSelf(meshA->particles,contacts,sBody->GetSelfCollisionsSpecifiedRadius());
+						if(particleGridIsReady){
+							//They're already tested with the particle grid.
+						}else if (meshA==meshB){
+							QCollision::CircleAndCircleSelf(meshA->particles,contactStream,sBody->GetSelfCollisionsSpecifiedRadius());
 						}else{
-							QCollision::CircleAndCircle(meshA->particles,meshB->particles,bodyAABB ,contacts,sBody->GetSelfCollisionsSpecifiedRadius());
+							QCollision::CircleAndCircle(meshA->particles,meshB->particles,bodyAABB ,contactStream,sBody->GetSelfCollisionsSpecifiedRadius());
 						}
-						if(contacts.size()>0){
-							QManifold manifold(sBody,sBody);
-							manifold.contacts=contacts;
+						if(contactStream.size()>contactsBegin){
+							QManifold manifold(sBody,sBody,&contactStream,contactsBegin,contactStream.size()-contactsBegin);
 							manifold.Solve();
 						}
-						contacts.clear();
+						contactStream.resize(contactsBegin);
 						//Polyline Collisions
 						if(QMesh::CheckCollisionBehaviors(meshA,meshB,QMesh::CollisionBehaviors::POLYLINE,QMesh::CollisionBehaviors::POLYLINE)){ //Self Polyline Collisions
 							if(sBody->GetAreaPreservingEnabled()==true){
 								//QCollision::CircleAndPolyline(meshA->polygon,meshB->polygon,contacts);
 							}else{
-								QCollision::PolylineAndPolygon(meshA->polygon,meshB->polygon,contacts);
+								QCollision::PolylineAndPolygon(meshA->polygon,meshB->polygon,contactStream);
 								
 							}
 							
@@ -271,15 +338,15 @@ void QWorld::Update(){
 						}else if(QMesh::CheckCollisionBehaviors(meshA,meshB,QMesh::CollisionBehaviors::CIRCLES,QMesh::CollisionBehaviors::POLYLINE) ){ //Self Polyline-Particle Collisions
 							QMesh * circleMesh=meshA->GetCollisionBehavior()==QMesh::CollisionBehaviors::CIRCLES ? meshA:meshB;
 							QMesh * polylineMesh=circleMesh==meshA ? meshB:meshA;
-							QCollision::CircleAndPolygon( polylineMesh->polygon,circleMesh->particles,contacts);
+							QCollision::CircleAndPolygon( polylineMesh->polygon,circleMesh->particles,contactStream);
 
 						}
 
-						if(contacts.size()>0){
-							QManifold manifold(sBody,sBody);
-							manifold.contacts=contacts;
+						if(contactStream.size()>contactsBegin){
+							QManifold manifold(sBody,sBody,&contactStream,contactsBegin,contactStream.size()-contactsBegin);
 							manifold.Solve();
 						}
+						contactStream.resize(contactsBegin);
 						
 					}
 					
@@ -294,10 +361,20 @@ void QWorld::Update(){
 
 		}
 
-
+		if(enableAdaptiveIterations && n+1<iterationCount){
+			if(UpdateIterationConvergence(n)==false)
+				break;
+		}
 
 
 	}
+	particleGridIsReady=false;
+	if(enableAdaptiveIterations){
+		for(auto body:bodies){
+			body->iterationsConverged=false;
+			body->iterationMoved=false;
+		}
+	}
 
 	
 	for(auto body:bodies){
@@ -635,12 +712,7 @@ vector<QManifold> QWorld::TestCollisionWithWorld(QBody *body)
 						mesh->UpdatePolygonBisectors();
 					}
 
-					vector<QCollision::Contact*> contacts=GetCollisions(body,otherBody);
-					if(contacts.size()>0){
-						QManifold manifold(body,otherBody);
-						manifold.contacts=contacts;
-						manifoldList.push_back(manifold);
-					}
+					CreateManifold(body,otherBody,manifoldList);
 
 
 				}
@@ -666,6 +738,8 @@ void QWorld::ClearBodies(){
 	}
 	
 	bodies.clear();
+	contactImpulses.clear();
+	previousContactImpulses.clear();
 }
 QWorld* QWorld::ClearJoints(){
 	for(int i=0;i<joints.size();i++){
@@ -926,6 +1000,11 @@ bool QWorld::CheckCollisionException(QBody *bodyA, QBody *bodyB)
 //Collision Constraints and Response Between Bodies
 vector<QCollision::Contact*> QWorld::GetCollisions(QBody *bodyA, QBody *bodyB){
 	vector<QCollision::Contact*> contactList;
+	GetCollisions(bodyA,bodyB,contactList);
+	return contactList;
+}
+
+void QWorld::GetCollisions(QBody *bodyA, QBody *bodyB,vector<QCollision::Contact*> &contactList){
 
 	vector<QMesh*>* meshesA=bodyA->GetMeshes();
 	vector<QMesh*>* meshesB=bodyB->GetMeshes();
@@ -944,49 +1023,80 @@ vector<QCollision::Contact*> QWorld::GetCollisions(QBody *bodyA, QBody *bodyB){
 			bodyA->GetWorld()->debugCollisionTestCount+=1;
 			if(QMesh::CheckCollisionBehaviors(meshA,meshB,QMesh::POLYGONS, QMesh::POLYGONS )){
 				
-				vector<vector< QCollision::Contact*>> contactListPerPolygons;
-
-				for(int a=0;a<meshA->GetSubConvexPolygonCount();a++){
-					vector<QCollision::Contact*> testContactList;
-					for(int b=0;b<meshB->GetSubConvexPolygonCount();b++){
-						QCollision::PolygonAndPolygon(meshA->GetSubConvexPolygonAt(a),meshB->GetSubConvexPolygonAt(b),testContactList);
-
+				size_t meshContactsBegin=contactList.size();
+				int collidedPolygonCount=0;
+				float maxPenetration=-MAX_WORLD_SIZE;
+				QCollision::Contact *deepestContact=nullptr;
+
+				int polygonCountA=meshA->GetSubConvexPolygonCount();
+				int polygonCountB=meshB->GetSubConvexPolygonCount();
+
+				//Concave meshes are tested with their convex hulls first. A convex mesh is its own hull.
+				if(polygonCountA>1 || polygonCountB>1){
+					QCollision::ConvexPolygonCache *hullA=polygonCountA==1 ? &meshA->GetSubConvexPolygonCacheAt(0) : meshA->GetConvexHullCache();
+					QCollision::ConvexPolygonCache *hullB=polygonCountB==1 ? &meshB->GetSubConvexPolygonCacheAt(0) : meshB->GetConvexHullCache();
+					if(hullA!=nullptr && hullB!=nullptr){
+						if(QCollision::CheckArePolygonsSeparated(*hullA,*hullB) )
+							continue;
 					}
-					if(testContactList.size()>0 )
-						contactListPerPolygons.push_back(testContactList);
 				}
-				if (contactListPerPolygons.size()>0 ){
-					if (contactListPerPolygons.size()==1){
-						contactList=contactListPerPolygons[0];
-					}else if(contactListPerPolygons.size()>1){
-						//Exceptional of the concave polygons
-						float maxPenetration=-MAX_WORLD_SIZE;
-						size_t winnerPolygonContactsIndex=-1;
-						size_t winnerContactIndex=-1;
-						for(int i=0;i<contactListPerPolygons.size();++i ){
-							vector<QCollision::Contact *> polygonContacts=contactListPerPolygons[i];
-							for (int j=0;j<polygonContacts.size();++j ){
-								QCollision::Contact * contact=polygonContacts[j];
-								if(contact->penetration>maxPenetration){
-									maxPenetration=contact->penetration;
-									winnerContactIndex=j;
-									winnerPolygonContactsIndex=i;
-								}
+
+				//The impulse solver needs both corners of the resting rigid pairs.
+				bool findTwoSidedContacts=bodyA->GetWorld()->contactSolver==ContactSolvers::SEQUENTIAL_IMPULSE && bodyA->simulationModel==QBody::SimulationModels::RIGID_BODY && bodyB->simulationModel==QBody::SimulationModels::RIGID_BODY;
+
+				meshB->UpdateSubConvexPolygonCaches();
+				for(int a=0;a<polygonCountA;a++){
+					size_t polygonContactsBegin=contactList.size();
+					QCollision::ConvexPolygonCache &cacheA=meshA->GetSubConvexPolygonCacheAt(a);
+					if(polygonCountB==1){
+						if(polygonCountA==1 || cacheA.aabb.isCollidingWith(meshB->GetSubConvexPolygonCacheAt(0).aabb) )
+							QCollision::PolygonAndPolygon(meshA->GetSubConvexPolygonAt(a),cacheA,meshB->GetSubConvexPolygonAt(0),meshB->GetSubConvexPolygonCacheAt(0),contactList,findTwoSidedContacts);
+					}else{
+						//Only the sub polygons overlapping with the bounding box of the sub polygon reach the separating axis tests.
+						vector<QMesh::BVHNode> &bvh=meshB->subConvexPolygonBVH;
+						int stack[64];
+						int stackSize=0;
+						stack[stackSize++]=0;
+						while(stackSize>0){
+							QMesh::BVHNode &node=bvh[stack[--stackSize]];
+							if(cacheA.aabb.isCollidingWith(node.aabb)==false)
+								continue;
+							if(node.leafIndex!=-1){
+								int b=node.leafIndex;
+								QCollision::PolygonAndPolygon(meshA->GetSubConvexPolygonAt(a),cacheA,meshB->GetSubConvexPolygonAt(b),meshB->GetSubConvexPolygonCacheAt(b),contactList,findTwoSidedContacts);
+							}else{
+								stack[stackSize++]=node.right;
+								stack[stackSize++]=node.left;
 							}
-							
 						}
-						//cout<<"Contact Index:"<<winnerContactIndex<<endl;
-						contactList.push_back(contactListPerPolygons[winnerPolygonContactsIndex][winnerContactIndex] );
-
 					}
-					
-					
+					if(contactList.size()>polygonContactsBegin ){
+						collidedPolygonCount+=1;
+						for(size_t i=polygonContactsBegin;i<contactList.size();++i ){
+							QCollision::Contact * contact=contactList[i];
+							if(contact->penetration>maxPenetration){
+								maxPenetration=contact->penetration;
+								deepestContact=contact;
+							}
+						}
+					}
+				}
+				if(collidedPolygonCount>1){
+					//Exceptional of the concave polygons
+					contactList.resize(meshContactsBegin);
+					contactList.push_back(deepestContact);
 				}
 
 
 			}else if(QMesh::CheckCollisionBehaviors(meshA,meshB,QMesh::CIRCLES, QMesh::POLYGONS )){
 				QMesh *circleMesh=meshA->collisionBehavior==QMesh::CIRCLES ? meshA:meshB;
 				QMesh *polygonMesh=&circleMesh->particles==&meshA->particles ? meshB :meshA;
+
+				//Rigid circles against convex polygons (e.g. boxes) are rejected with the cached separating axes first.
+				if(circleMesh->particles.size()==1 && polygonMesh->GetSubConvexPolygonCount()==1 && polygonMesh->GetOwnerBody()->GetSimulationModel()==QBody::SimulationModels::RIGID_BODY ){
+					if(QCollision::CheckIsCircleSeparatedFromPolygon(circleMesh->particles[0],polygonMesh->GetSubConvexPolygonCacheAt(0) ) )
+						continue;
+				}
 				
 				QCollision::CircleAndPolygon(circleMesh->particles,polygonMesh->polygon,contactList);
 				
@@ -996,7 +1106,12 @@ vector<QCollision::Contact*> QWorld::GetCollisions(QBody *bodyA, QBody *bodyB){
 				if(bodyA->GetBodyType()==QBody::BodyTypes::RIGID && bodyB->GetBodyType()==QBody::BodyTypes::RIGID){
 					velocitySensitive=true;
 				}
-				QCollision::CircleAndCircle(meshA->particles,meshB->particles,bboxB,contactList,0.0f,velocitySensitive);
+				QWorld *world=bodyA->GetWorld();
+				if(world!=nullptr && world->particleGridIsReady && meshA->particleGridOffset!=-1 && meshB->particleGridOffset!=-1){
+					QCollision::CircleAndCircle(meshA->particles,meshB,world->particleGrid,bboxB,contactList,0.0f,velocitySensitive);
+				}else{
+					QCollision::CircleAndCircle(meshA->particles,meshB->particles,bboxB,contactList,0.0f,velocitySensitive);
+				}
 
 			}else if(QMesh::CheckCollisionBehaviors(meshA,meshB,QMesh::POLYLINE, QMesh::POLYGONS )){
 				QMesh *polylineMesh=meshA->collisionBehavior==QMesh::POLYLINE ? meshA:meshB;
@@ -1013,12 +1128,13 @@ vector<QCollision::Contact*> QWorld::GetCollisions(QBody *bodyA, QBody *bodyB){
 					QCollision::CircleAndPolygon(polylineMesh->polygon,polygonMesh->polygon,contactList);
 					QCollision::CircleAndPolygon(polygonMesh->polygon,polylineMesh->polygon,contactList);
 				}else{
-					vector<QCollision::Contact*> hotContactList;
-					QManifold hotManifold(bodyA,bodyB);
-					QCollision::CircleAndPolygon(polylineMesh->polygon,polygonMesh->polygon,hotContactList);
-					hotManifold.contacts=hotContactList;
+					//Hot contacts are solved immediately, so they are removed from the contact list after solving.
+					size_t hotContactsBegin=contactList.size();
+					QCollision::CircleAndPolygon(polylineMesh->polygon,polygonMesh->polygon,contactList);
+					QManifold hotManifold(bodyA,bodyB,&contactList,hotContactsBegin,contactList.size()-hotContactsBegin);
 					hotManifold.Solve();
 					hotManifold.SolveFrictionAndVelocities();
+					contactList.resize(hotContactsBegin);
 					
 					QCollision::PolylineAndPolygon(polylineMesh->polygon,polygonMesh->polygon,contactList);
 					
@@ -1051,15 +1167,18 @@ vector<QCollision::Contact*> QWorld::GetCollisions(QBody *bodyA, QBody *bodyB){
 
 	}
 
+}
 
-
-	return contactList;
-
-
-
-
-
-
+void QWorld::CreateManifold(QBody *bodyA, QBody *bodyB, vector<QManifold> &manifoldList)
+{
+	//The converged islands of the adaptive iterations
+	if(bodyA->iterationsConverged && bodyB->iterationsConverged)
+		return;
+	size_t contactsBegin=contactStream.size();
+	GetCollisions(bodyA,bodyB,contactStream);
+	if(contactStream.size()>contactsBegin){
+		manifoldList.push_back(QManifold(bodyA,bodyB,&contactStream,contactsBegin,contactStream.size()-contactsBegin) );
+	}
 }
 
 //Collision Islands
@@ -1119,6 +1238,173 @@ void QWorld::GenerateIslands(vector<QBody *> &bodyList, vector<vector<QBody *>>
 	}
 }
 
+float QWorld::GetIterationResidual(float error, float &previousError)
+{
+	//The resting contacts and the soft springs keep some error that more iterations can't solve, so the change of the error since the previous iteration is used when it's higher than the tolerance.
+	float residual=error;
+	if(error>=adaptiveIterationsTolerance && previousError>=0.0f){
+		residual=abs(error-previousError);
+	}
+	previousError=error;
+	return residual;
+}
+
+int QWorld::FindIterationIsland(int index)
+{
+	while(iterationIslandParents[index]!=index){
+		iterationIslandParents[index]=iterationIslandParents[iterationIslandParents[index] ];
+		index=iterationIslandParents[index];
+	}
+	return index;
+}
+
+void QWorld::UniteIterationIslands(QBody *bodyA, QBody *bodyB)
+{
+	if(bodyA==nullptr || bodyB==nullptr)
+		return;
+	if(bodyA->GetMode()==QBody::Modes::STATIC || bodyB->GetMode()==QBody::Modes::STATIC)
+		return;
+	int islandA=FindIterationIsland(bodyA->iterationIslandIndex);
+	int islandB=FindIterationIsland(bodyB->iterationIslandIndex);
+	if(islandA!=islandB)
+		iterationIslandParents[islandB]=islandA;
+}
+
+bool QWorld::CheckIterationLinkCanBeSolved(QBody *bodyA, QBody *bodyB)
+{
+	//The particles without bodies and the world anchors are treated like converged bodies
+	bool convergedA=bodyA==nullptr || bodyA->iterationsConverged;
+	bool convergedB=bodyB==nullptr || bodyB->iterationsConverged;
+	if(convergedA && convergedB)
+		return false;
+	if(bodyA!=nullptr && convergedA && bodyA->GetMode()!=QBody::Modes::STATIC)
+		bodyA->iterationMoved=true;
+	if(bodyB!=nullptr && convergedB && bodyB->GetMode()!=QBody::Modes::STATIC)
+		bodyB->iterationMoved=true;
+	return true;
+}
+
+bool QWorld::UpdateIterationConvergence(int iterationIndex)
+{
+	//The island flags
+	const char hasActiveBodies=1;
+	const char hasLinks=2;
+	const char hasAwakeBodies=4;
+
+	int bodyCount=bodies.size();
+	iterationIslandParents.resize(bodyCount);
+	for(int i=0;i<bodyCount;++i){
+		iterationIslandParents[i]=i;
+	}
+	iterationIslandResiduals.assign(bodyCount,0.0f);
+	iterationIslandMinimums.assign(bodyCount,0);
+	iterationIslandMaximums.assign(bodyCount,0);
+	iterationIslandFlags.assign(bodyCount,0);
+
+	//Islands
+	for(auto &manifold:manifolds){
+		UniteIterationIslands(manifold.bodyA,manifold.bodyB);
+	}
+	for(auto spring:springs){
+		if(spring->GetParticleA()==nullptr || spring->GetParticleB()==nullptr)
+			continue;
+		QMesh *meshA=spring->GetParticleA()->GetOwnerMesh();
+		QMesh *meshB=spring->GetParticleB()->GetOwnerMesh();
+		UniteIterationIslands(meshA!=nullptr ? meshA->GetOwnerBody() : nullptr,meshB!=nullptr ? meshB->GetOwnerBody() : nullptr );
+	}
+	for(auto joint:joints){
+		UniteIterationIslands(joint->GetBodyA(),joint->GetBodyB() );
+	}
+
+	//The islands with the joints and the world springs aren't measured
+	for(auto spring:springs){
+		QParticle *particles[2]={spring->GetParticleA(),spring->GetParticleB()};
+		for(int i=0;i<2;++i){
+			if(particles[i]==nullptr || particles[i]->GetOwnerMesh()==nullptr)
+				continue;
+			QBody *body=particles[i]->GetOwnerMesh()->GetOwnerBody();
+			if(body!=nullptr && body->GetMode()!=QBody::Modes::STATIC)
+				iterationIslandFlags[FindIterationIsland(body->iterationIslandIndex)]|=hasLinks;
+		}
+	}
+	for(auto joint:joints){
+		QBody *jointBodies[2]={joint->GetBodyA(),joint->GetBodyB()};
+		for(int i=0;i<2;++i){
+			if(jointBodies[i]!=nullptr && jointBodies[i]->GetMode()!=QBody::Modes::STATIC)
+				iterationIslandFlags[FindIterationIsland(jointBodies[i]->iterationIslandIndex)]|=hasLinks;
+		}
+	}
+
+	//Penetrations of the contacts
+	iterationBodyPenetrations.assign(bodyCount,0.0f);
+	for(auto &manifold:manifolds){
+		float penetration=0.0f;
+		for(size_t i=0;i<manifold.contactCount;++i){
+			penetration=max(penetration,abs(manifold.GetContactAt(i)->penetration) );
+		}
+		if(manifold.bodyA->GetMode()!=QBody::Modes::STATIC)
+			iterationBodyPenetrations[manifold.bodyA->iterationIslandIndex]=max(iterationBodyPenetrations[manifold.bodyA->iterationIslandIndex],penetration);
+		if(manifold.bodyB->GetMode()!=QBody::Modes::STATIC)
+			iterationBodyPenetrations[manifold.bodyB->iterationIslandIndex]=max(iterationBodyPenetrations[manifold.bodyB->iterationIslandIndex],penetration);
+	}
+
+	for(int i=0;i<bodyCount;++i){
+		QBody *body=bodies[i];
+		if(body->GetMode()==QBody::Modes::STATIC)
+			continue;
+		int island=FindIterationIsland(i);
+		iterationIslandMinimums[island]=max(iterationIslandMinimums[island],body->minimumIterationCount);
+		iterationIslandMaximums[island]=max(iterationIslandMaximums[island],body->maximumIterationCount>0 ? body->maximumIterationCount : iteration);
+		if(body->iterationsConverged)
+			continue;
+		iterationIslandFlags[island]|=hasActiveBodies;
+		if(body->isSleeping==false)
+			iterationIslandFlags[island]|=hasAwakeBodies;
+
+		float &residual=iterationIslandResiduals[island];
+		residual=max(residual,GetIterationResidual(iterationBodyPenetrations[i],body->iterationPenetration) );
+
+		//Errors of the springs
+		if(body->GetSimulationModel()!=QBody::SimulationModels::RIGID_BODY && body->isSleeping==false){
+			QSoftBody *sBody=static_cast<QSoftBody*>(body);
+			float constraintError=0.0f;
+			for(auto mesh:sBody->_meshes){
+				for(auto spring:mesh->springs){
+					if(spring->GetEnabled()==false)
+						continue;
+					if(spring->GetIsInternal() && sBody->GetPassivationOfInternalSpringsEnabled() )
+						continue;
+					float length=(spring->GetParticleB()->GetGlobalPosition()-spring->GetParticleA()->GetGlobalPosition() ).Length();
+					constraintError=max(constraintError,abs(length-spring->GetLength() ) );
+				}
+			}
+			residual=max(residual,GetIterationResidual(constraintError,body->iterationConstraintError) );
+		}
+	}
+
+	bool hasBodiesToSolve=false;
+	int solvedIterationCount=iterationIndex+1;
+	for(int i=0;i<bodyCount;++i){
+		QBody *body=bodies[i];
+		if(body->GetMode()==QBody::Modes::STATIC)
+			continue;
+		int island=FindIterationIsland(i);
+		//The islands whose all bodies were converged stay converged
+		if( (iterationIslandFlags[island] & hasActiveBodies)==0 )
+			continue;
+		//The islands whose all bodies are sleeping aren't moved by the constraints
+		bool converged=solvedIterationCount>=iterationIslandMaximums[island] || (iterationIslandFlags[island] & hasAwakeBodies)==0;
+		if( (iterationIslandFlags[island] & hasLinks)==0 && solvedIterationCount>=iterationIslandMinimums[island] && iterationIslandResiduals[island]<adaptiveIterationsTolerance){
+			converged=true;
+		}
+		body->iterationsConverged=converged;
+		if(converged==false)
+			hasBodiesToSolve=true;
+	}
+
+	return hasBodiesToSolve;
+}
+
 bool QWorld::SortBodiesHorizontal(const QBody *bodyA, const QBody *bodyB)
 {
 	if(bodyA->GetAABB().GetMin().x==bodyB->GetAABB().GetMin().x){
@@ -1168,7 +1454,56 @@ bool QWorld::SortBodiesVertical(const QBody *bodyA, const QBody *bodyB)
 
  }
 
- void QWorld::UpdateConstraints()
+ void QWorld::UpdateParticleGrid()
+{
+	particleGrid.Clear();
+	particleGridHasSelfCollisions=false;
+	float maxRadius=0.0f;
+	for(auto body:bodies){
+		bool hasSelfCollisions=false;
+		float selfCollisionsRadius=0.0f;
+		if(body->simulationModel!=QBody::SimulationModels::RIGID_BODY){
+			QSoftBody *sBody=static_cast<QSoftBody*>(body);
+			hasSelfCollisions=sBody->GetSelfCollisionsEnabled();
+			selfCollisionsRadius=sBody->GetSelfCollisionsSpecifiedRadius();
+			particleGridHasSelfCollisions|=hasSelfCollisions;
+		}
+		for(auto mesh:body->_meshes){
+			//Single circles are tested with the closed form test, they don't need the grid.
+			bool isCircleMesh=mesh->GetCollisionBehavior()==QMesh::CIRCLES && mesh->particles.size()>1;
+			if(isCircleMesh==false && hasSelfCollisions==false){
+				mesh->particleGridOffset=-1;
+				continue;
+			}
+			mesh->particleGridOffset=particleGrid.GetParticleCount();
+			for(auto particle:mesh->particles){
+				particleGrid.Insert(particle);
+				maxRadius=max(maxRadius,particle->GetRadius() );
+			}
+			maxRadius=max(maxRadius,selfCollisionsRadius);
+		}
+	}
+	particleGrid.Build(maxRadius*2.0f);
+	particleGridIsReady=true;
+}
+
+QManifold::AccumulatedImpulse &QWorld::GetAccumulatedImpulse(QCollision::Contact *contact, bool &isFirstInStep)
+{
+	QContactKey key(contact);
+	auto it=contactImpulses.find(key);
+	if(it!=contactImpulses.end() ){
+		isFirstInStep=false;
+		return it->second;
+	}
+	isFirstInStep=true;
+	QManifold::AccumulatedImpulse &accumulated=contactImpulses[key];
+	auto previous=previousContactImpulses.find(key);
+	if(previous!=previousContactImpulses.end() )
+		accumulated=previous->second;
+	return accumulated;
+}
+
+void QWorld::UpdateConstraints(bool isFirstIteration)
  {
 
 
@@ -1178,7 +1513,7 @@ bool QWorld::SortBodiesVertical(const QBody *bodyA, const QBody *bodyB)
 	 //Other Soft Body Constraints
 	 for(auto body:bodies){
 
-		if(body->isSleeping)
+		if(body->isSleeping || body->iterationsConverged)
 			continue;
 
 		//Time scale feature
@@ -1194,6 +1529,26 @@ bool QWorld::SortBodiesVertical(const QBody *bodyA, const QBody *bodyB)
 
 		 if(body->GetMode()!=QBody::STATIC && body->GetSimulationModel()!=QBody::SimulationModels::RIGID_BODY){
 			 QSoftBody *sBody=static_cast<QSoftBody*>(body);
+			 bool useCompliance=constraintSolver==ConstraintSolvers::XPBD;
+
+			 //The springs and the angle constraints of the batched meshes are solved after all bodies
+			 if(enableBatchedConstraints && useCompliance==false){
+				 for(int i=0;i<sBody->GetMeshCount();i++){
+					 QMesh * mesh=sBody->GetMeshAt(i);
+					 if(isFirstIteration || mesh->packedSprings.positionsX.size()!=mesh->particles.size() ){
+						 mesh->RefreshPackedSprings(sBody->GetPassivationOfInternalSpringsEnabled() );
+					 }
+					 if(isFirstIteration || mesh->packedAngleConstraints.positionsX.size()!=mesh->particles.size() ){
+						 mesh->RefreshPackedAngleConstraints();
+					 }
+					 BatchedConstraintMesh batchedMesh;
+					 batchedMesh.body=sBody;
+					 batchedMesh.mesh=mesh;
+					 batchedMesh.timeScale=ts;
+					 batchedConstraintMeshes.push_back(batchedMesh);
+				 }
+				 continue;
+			 }
 			
 			 for(int i=0;i<sBody->GetMeshCount();i++){
 				 QMesh * mesh=sBody->GetMeshAt(i);
@@ -1202,7 +1557,13 @@ bool QWorld::SortBodiesVertical(const QBody *bodyA, const QBody *bodyB)
 				 }
 
 				 for(auto spring:mesh->springs){
-					 spring->Update(sBody->GetRigidity()*ts,sBody->GetPassivationOfInternalSpringsEnabled(),false);
+					 if(useCompliance){
+						 if(isFirstIteration)
+							 spring->ResetLagrangeMultiplier();
+						 spring->UpdateWithCompliance(sBody->GetCompliance(),ts,sBody->GetPassivationOfInternalSpringsEnabled(),false);
+					 }else{
+						 spring->Update(sBody->GetRigidity()*ts,sBody->GetPassivationOfInternalSpringsEnabled(),false);
+					 }
 				 }
 
 				 for(auto particle:mesh->particles){
@@ -1217,7 +1578,13 @@ bool QWorld::SortBodiesVertical(const QBody *bodyA, const QBody *bodyB)
 				 }
 
 				 for(auto angleConstraint:mesh->angleConstraints){
-					 angleConstraint->Update(angleConstraint->GetRigidity()*ts,false);
+					 if(useCompliance){
+						 if(isFirstIteration)
+							 angleConstraint->ResetLagrangeMultiplier();
+						 angleConstraint->UpdateWithCompliance(angleConstraint->GetCompliance(),ts);
+					 }else{
+						 angleConstraint->Update(angleConstraint->GetRigidity()*ts,false);
+					 }
 				 }
 
 				 for(auto particle:mesh->particles){
@@ -1232,14 +1599,228 @@ bool QWorld::SortBodiesVertical(const QBody *bodyA, const QBody *bodyB)
 	 }
 	 
 	 
+	 if(batchedConstraintMeshes.empty()==false){
+		 SolveBatchedConstraints();
+	 }
+
 	 for(auto spring:springs){
-		 spring->Update(spring->GetRigidity(),false,true);
+		 if(enableAdaptiveIterations && spring->GetParticleA()!=nullptr && spring->GetParticleB()!=nullptr){
+			 QMesh *meshA=spring->GetParticleA()->GetOwnerMesh();
+			 QMesh *meshB=spring->GetParticleB()->GetOwnerMesh();
+			 if(CheckIterationLinkCanBeSolved(meshA!=nullptr ? meshA->GetOwnerBody() : nullptr,meshB!=nullptr ? meshB->GetOwnerBody() : nullptr)==false)
+				 continue;
+		 }
+		 if(constraintSolver==ConstraintSolvers::XPBD){
+			 if(isFirstIteration)
+				 spring->ResetLagrangeMultiplier();
+			 spring->UpdateWithCompliance(spring->GetCompliance(),GetTimeScale(),false,true);
+		 }else{
+			 spring->Update(spring->GetRigidity(),false,true);
+		 }
 	 }
 	 //Joint Constraints
 	 for(auto joint:joints){
+		 if(enableAdaptiveIterations && CheckIterationLinkCanBeSolved(joint->GetBodyA(),joint->GetBodyB() )==false)
+			 continue;
 		 joint->Update();
 	 }
  }
 
+void QWorld::SolveBatchedConstraints()
+{
+	//The bodies don't share particles, so they can be solved on different threads. The meshes of a body are solved on the same thread, since they update the same body.
+	const int minimumConstraintCountPerTask=2048;
+	int constraintCount=0;
+	for(size_t i=0;i<batchedConstraintMeshes.size();++i){
+		constraintCount+=batchedConstraintMeshes[i].mesh->packedSprings.springCount;
+		constraintCount+=batchedConstraintMeshes[i].mesh->packedAngleConstraints.constraintCount;
+	}
+	int taskCount=min( (int)thread::hardware_concurrency(),constraintCount/minimumConstraintCountPerTask );
+	taskCount=min(taskCount,(int)batchedConstraintMeshes.size() );
+
+	if(taskCount>1){
+		int meshCount=batchedConstraintMeshes.size();
+		int begin=0;
+		for(int t=0;t<taskCount;++t){
+			int end=max(begin,(meshCount*(t+1))/taskCount);
+			//The meshes of a body are consecutive in the list, the tasks are split at the body boundaries.
+			while(end>0 && end<meshCount && batchedConstraintMeshes[end].body==batchedConstraintMeshes[end-1].body){
+				++end;
+			}
+			if(end==begin)
+				continue;
+			if(end==meshCount){
+				SolveBatchedConstraintMeshes(batchedConstraintMeshes.data()+begin,end-begin);
+			}else{
+				batchedConstraintTasks.push_back(async(launch::async,SolveBatchedConstraintMeshes,batchedConstraintMeshes.data()+begin,end-begin) );
+			}
+			begin=end;
+		}
+		for(size_t t=0;t<batchedConstraintTasks.size();++t){
+			batchedConstraintTasks[t].wait();
+		}
+		batchedConstraintTasks.clear();
+	}else{
+		SolveBatchedConstraintMeshes(batchedConstraintMeshes.data(),batchedConstraintMeshes.size() );
+	}
+
+	//The unpacked springs and angle constraints
+	for(size_t i=0;i<batchedConstraintMeshes.size();++i){
+		QSoftBody *sBody=batchedConstraintMeshes[i].body;
+		QMesh *mesh=batchedConstraintMeshes[i].mesh;
+		float ts=batchedConstraintMeshes[i].timeScale;
+
+		if(mesh->packedSprings.unpackedSprings.empty()==false){
+			for(auto particle:mesh->particles){
+				particle->ClearAccumulatedForces();
+			}
+			for(auto spring:mesh->packedSprings.unpackedSprings){
+				spring->Update(sBody->GetRigidity()*ts,sBody->GetPassivationOfInternalSpringsEnabled(),false);
+			}
+			for(auto particle:mesh->particles){
+				particle->ApplyAccumulatedForces();
+			}
+		}
+
+		for(auto angleConstraint:mesh->packedAngleConstraints.unpackedConstraints){
+			angleConstraint->Update(angleConstraint->GetRigidity()*ts,false);
+		}
+	}
+	batchedConstraintMeshes.clear();
+}
+
+void QWorld::SolveBatchedConstraintMeshes(BatchedConstraintMesh *meshes, int count)
+{
+	for(int i=0;i<count;++i){
+		meshes[i].mesh->SolvePackedSprings(meshes[i].body->GetRigidity()*meshes[i].timeScale);
+		meshes[i].mesh->SolvePackedAngleConstraints(meshes[i].timeScale);
+	}
+}
+
+void QWorld::IntegrateBatchedRigidBodies()
+{
+	BatchedRigidBodies &b=batchedRigidBodies;
+	size_t count=b.bodies.size();
+
+	b.positionX.resize(count);
+	b.positionY.resize(count);
+	b.prevPositionX.resize(count);
+	b.prevPositionY.resize(count);
+	b.rotation.resize(count);
+	b.prevRotation.resize(count);
+	b.velocityX.resize(count);
+	b.velocityY.resize(count);
+	b.angularVelocity.resize(count);
+	b.forceX.resize(count);
+	b.forceY.resize(count);
+	b.angularForce.resize(count);
+	b.gravityX.resize(count);
+	b.gravityY.resize(count);
+	b.airFriction.resize(count);
+	b.velocityLimit.resize(count);
+	b.integrate.resize(count);
+
+	//Gathering the states of the bodies
+	for(size_t i=0;i<count;++i){
+		QRigidBody *body=b.bodies[i];
+		float ts=body->enableBodySpecificTimeScale==true ? body->bodySpecificTimeScale : timeScale;
+		bool integrate=body->isKinematic==false && body->enableIntegratedVelocities==true;
+
+		QVector gravityForce=QVector::Zero();
+		if(integrate && body->ignoreGravity==false){
+			gravityForce=body->enableCustomGravity ? body->customGravity*ts : gravity*ts;
+		}
+
+		b.positionX[i]=body->position.x;
+		b.positionY[i]=body->position.y;
+		b.prevPositionX[i]=body->prevPosition.x;
+		b.prevPositionY[i]=body->prevPosition.y;
+		b.rotation[i]=body->rotation;
+		b.prevRotation[i]=body->prevRotation;
+		b.forceX[i]=body->force.x;
+		b.forceY[i]=body->force.y;
+		b.angularForce[i]=body->angularForce;
+		b.gravityX[i]=gravityForce.x;
+		b.gravityY[i]=gravityForce.y;
+		b.airFriction[i]=body->airFriction;
+		b.velocityLimit[i]=body->velocityLimit;
+		b.integrate[i]=integrate ? 1.0f : 0.0f;
+	}
+
+	float *px=b.positionX.data();
+	float *py=b.positionY.data();
+	float *ppx=b.prevPositionX.data();
+	float *ppy=b.prevPositionY.data();
+	float *rot=b.rotation.data();
+	float *prot=b.prevRotation.data();
+	float *vx=b.velocityX.data();
+	float *vy=b.velocityY.data();
+	float *av=b.angularVelocity.data();
+
+	//Velocities
+	for(size_t i=0;i<count;++i){
+		float velX=px[i]-ppx[i];
+		float velY=py[i]-ppy[i];
+		//Reducing Float Errors
+		vx[i]=abs(velX)<0.01 ? 0.0f : velX;
+		vy[i]=abs(velY)<0.01 ? 0.0f : velY;
+		ppx[i]=px[i];
+		ppy[i]=py[i];
+
+		av[i]=rot[i]-prot[i];
+		prot[i]=rot[i];
+	}
+
+	//Velocity limits
+	for(size_t i=0;i<count;++i){
+		float limit=b.velocityLimit[i];
+		if(limit>0.0f){
+			QVector vel(vx[i],vy[i]);
+			if(vel.Length()>limit){
+				vel=limit*vel.Normalized();
+				vx[i]=vel.x;
+				vy[i]=vel.y;
+			}
+		}
+	}
+
+	//Verlet Integration, the positions of the bodies without the integrated velocities are only moved by the forces
+	const float *air=b.airFriction.data();
+	const float *integ=b.integrate.data();
+	const float *gx=b.gravityX.data();
+	const float *gy=b.gravityY.data();
+	const float *fx=b.forceX.data();
+	const float *fy=b.forceY.data();
+	const float *af=b.angularForce.data();
+	for(size_t i=0;i<count;++i){
+		float x=px[i];
+		float y=py[i];
+		float r=rot[i];
+		float ix=(x+(vx[i]-(vx[i]*air[i]) ) )+gx[i];
+		float iy=(y+(vy[i]-(vy[i]*air[i]) ) )+gy[i];
+		float ir=r+(av[i]-(av[i]*air[i]) );
+		x=integ[i]!=0.0f ? ix : x;
+		y=integ[i]!=0.0f ? iy : y;
+		r=integ[i]!=0.0f ? ir : r;
+		//Position and Angular Forces
+		px[i]=x+fx[i];
+		py[i]=y+fy[i];
+		rot[i]=r+af[i];
+	}
+
+	//Scattering the states and transforming the meshes
+	for(size_t i=0;i<count;++i){
+		QRigidBody *body=b.bodies[i];
+		body->position=QVector(px[i],py[i]);
+		body->prevPosition=QVector(ppx[i],ppy[i]);
+		body->rotation=rot[i];
+		body->prevRotation=prot[i];
+		body->force=QVector::Zero();
+		body->angularForce=0.0f;
+		body->UpdateMeshTransforms();
+		body->UpdateAABB();
+	}
+}
+
 
 
@@ -30,6 +30,7 @@
 #include <iostream>
 #include <map>
 #include <vector>
+#include <future>
 #include "qbody.h"
 #include "qjoint.h"
 #include "qvector.h"
@@ -49,6 +50,22 @@ using namespace std;
  * @brief A QWorld object is required to create a physics simulation. The QWorld class manages the entire physics simulation. You can add or remove objects to the physics world and make specific settings for the simulation. Additionally, the QWorld class is responsible for updating the simulation
  */
 class QWorld{
+public:
+	/** The contact solvers of the world. */
+	enum ContactSolvers{
+		/** The contacts are solved by moving the positions of the bodies. */
+		POSITIONAL,
+		/** The contacts between rigid bodies are solved with accumulated impulses on the velocity level. The other contacts are still solved with the positional solver. */
+		SEQUENTIAL_IMPULSE
+	};
+
+	/** The constraint solvers of the world. They're used for the springs and the angle constraints. */
+	enum ConstraintSolvers{
+		/** The constraints are solved with their rigidity values. Their stiffness depends on the iteration count and the time step. */
+		PBD,
+		/** The constraints are solved with their compliance values and accumulated Lagrange multipliers. Their stiffness is independent of the iteration count and the time step. */
+		XPBD
+	};
 
 protected:
 
@@ -62,7 +79,7 @@ protected:
 
 	vector<QRaycast*> raycasts=vector<QRaycast*>();
 
-	vector <QGizmo*> gizmos=vector<QGizmo*>();
+	QGizmoBuffer gizmos;
 
 	vector<vector<QBody*> > sleepingIslands=vector<vector<QBody*> >();
 
@@ -70,9 +87,45 @@ protected:
 
 	vector<QManifold> manifolds;
 
+	//The contacts of the current iteration. Manifolds refer to ranges of it.
+	vector<QCollision::Contact*> contactStream;
+
+	//The solver data of the contacts that are solved with the sequential impulse solver in the current iteration.
+	vector<QManifold::ImpulseContact> impulseContactStream;
+
 	//Broadphase
 	QBroadPhase *broadPhase=nullptr;
 
+	//The particle grid of the circle collisions. It's rebuilt in every iteration.
+	QParticleGrid particleGrid;
+	bool particleGridIsReady=false;
+	bool particleGridHasSelfCollisions=false;
+
+	//The accumulated impulses of the contacts in the current and the previous step. The previous ones warm start the sequential impulse solver.
+	unordered_map<QContactKey,QManifold::AccumulatedImpulse,QContactKeyHash> contactImpulses;
+	unordered_map<QContactKey,QManifold::AccumulatedImpulse,QContactKeyHash> previousContactImpulses;
+
+	//The soft body meshes whose springs and angle constraints are solved with the batched constraint solver in the current iteration.
+	struct BatchedConstraintMesh{
+		QSoftBody *body;
+		QMesh *mesh;
+		float timeScale;
+	};
+	vector<BatchedConstraintMesh> batchedConstraintMeshes;
+	vector<future<void>> batchedConstraintTasks;
+
+	//The awake dynamic rigid bodies which are integrated together in the current step. Their states are gathered into flat arrays (structure of arrays) during the integration.
+	struct BatchedRigidBodies{
+		vector<QRigidBody*> bodies;
+		vector<float> positionX,positionY,prevPositionX,prevPositionY;
+		vector<float> rotation,prevRotation;
+		vector<float> velocityX,velocityY,angularVelocity;
+		vector<float> forceX,forceY,angularForce;
+		vector<float> gravityX,gravityY;
+		vector<float> airFriction,velocityLimit,integrate;
+	};
+	BatchedRigidBodies batchedRigidBodies;
+
 	
 
 	//Physics World Properties
@@ -81,8 +134,16 @@ protected:
 	QVector gravity=QVector(0.0f,0.2f);
 	bool enableSleeping=true;
 	bool enableBroadphase=true;
+	bool enableDebugGizmos=false;
+	bool enableParticleGrid=false;
+	bool enableBatchedConstraints=false;
+	bool enableBatchedRigidBodyIntegration=false;
+	bool enableAdaptiveIterations=false;
+	float adaptiveIterationsTolerance=0.05f;
 	int iteration=4;
 	float timeScale=1.0f;
+	ContactSolvers contactSolver=ContactSolvers::POSITIONAL;
+	ConstraintSolvers constraintSolver=ConstraintSolvers::PBD;
 
 
 	//Sleeping
@@ -104,11 +165,41 @@ protected:
 	static bool SortBodiesVertical(const QBody *bodyA,const QBody *bodyB);
 	void GetCollisionPairs(vector<QBody *> &bodyList,vector<pair<QBody *, QBody *> > *resList);
 
+	//Appends the contacts of two bodies to the contact stream and adds a manifold for them to the list if they collide.
+	void CreateManifold(QBody *bodyA, QBody *bodyB, vector<QManifold> &manifoldList);
+
 	void CreateIslands(QBody &body, vector<QBody*> island);
 	vector<vector<QBody>> GenerateIslands(vector<QBody> bodyList );
 
-	//Constraints
-	void UpdateConstraints();
+	//Adaptive Iterations, the islands are the bodies connected with the manifolds, the joints and the springs of the current iteration. They're kept in a union-find list indexed by the iterationIslandIndex of the bodies.
+	vector<int> iterationIslandParents;
+	vector<float> iterationIslandResiduals;
+	vector<int> iterationIslandMinimums;
+	vector<int> iterationIslandMaximums;
+	vector<char> iterationIslandFlags;
+	vector<float> iterationBodyPenetrations;
+	float GetIterationResidual(float error,float &previousError);
+	int FindIterationIsland(int index);
+	void UniteIterationIslands(QBody *bodyA,QBody *bodyB);
+	//Returns whether a world spring or a joint between two bodies is solved in the current iteration. The links between two converged bodies aren't solved, a converged body moved by a link is marked to refresh its AABB.
+	bool CheckIterationLinkCanBeSolved(QBody *bodyA,QBody *bodyB);
+	//Marks the bodies of the converged islands after the iteration, returns whether there is any body to solve in the next iteration.
+	bool UpdateIterationConvergence(int iterationIndex);
+
+	//Constraints, the Lagrange multipliers of the XPBD solver are reset in the first iteration of the step.
+	void UpdateConstraints(bool isFirstIteration=false);
+	//Solves the packed springs and angle constraints of the batched meshes, the meshes are distributed to the worker threads if there are enough constraints.
+	void SolveBatchedConstraints();
+	static void SolveBatchedConstraintMeshes(BatchedConstraintMesh *meshes,int count);
+
+	//Integrates the gathered rigid bodies with the Verlet integration, then updates their mesh transforms and AABBs.
+	void IntegrateBatchedRigidBodies();
+
+	//Inserts the particles of the soft body meshes and the multi-particle circle meshes to the particle grid.
+	void UpdateParticleGrid();
+
+	//Returns the accumulated impulses of a contact in the step. If the contact is new in the step, its impulses are taken from the previous step.
+	QManifold::AccumulatedImpulse &GetAccumulatedImpulse(QCollision::Contact *contact,bool &isFirstInStep);
 
 	
 
@@ -130,6 +221,15 @@ public:
 	}
 
 	
+	/** Returns whether the adaptive iterations are enabled. */
+	bool GetAdaptiveIterationsEnabled(){
+		return enableAdaptiveIterations;
+	}
+	/** Returns the tolerance of the adaptive iterations. An island is converged when its maximum penetration and spring error are lower than this value. */
+	float GetAdaptiveIterationsTolerance(){
+		return adaptiveIterationsTolerance;
+	}
+
 	/** Returns whether sleep mode will be applied to dynamic objects.
 	 */
 	bool GetSleepingEnabled(){
@@ -176,6 +276,39 @@ public:
 		return enabled;
 	}
 
+	/** Returns whether the debug gizmos are collected during the physics steps. */
+	bool GetDebugGizmosEnabled(){
+		return enableDebugGizmos;
+	}
+
+	/** Returns whether the particle grid is used for the circle collisions of the soft bodies. */
+	bool GetParticleGridEnabled(){
+		return enableParticleGrid;
+	}
+
+	/** Returns whether the springs and the angle constraints of the soft bodies are solved with the batched constraint solver. */
+	bool GetBatchedConstraintsEnabled(){
+		return enableBatchedConstraints;
+	}
+	/** Returns whether the springs of the soft bodies are solved with the batched constraint solver. It's the same with GetBatchedConstraintsEnabled(). */
+	bool GetBatchedSpringsEnabled(){
+		return enableBatchedConstraints;
+	}
+	/** Returns whether the awake dynamic rigid bodies are integrated together with the batched integration. */
+	bool GetBatchedRigidBodyIntegrationEnabled(){
+		return enableBatchedRigidBodyIntegration;
+	}
+
+	/** Returns the contact solver of the world. */
+	ContactSolvers GetContactSolver(){
+		return contactSolver;
+	}
+
+	/** Returns the constraint solver of the world. */
+	ConstraintSolvers GetConstraintSolver(){
+		return constraintSolver;
+	}
+
 	//General Set Methods
 	/** Sets the gravity force of the world.
 	 * The gravity force applies to dynamic bodies in every step of physics.
@@ -213,6 +346,82 @@ public:
 		return this;
 	}
 
+	/** Sets whether the debug gizmos are collected during the physics steps. Gizmos are only useful for debug rendering, so it's disabled by default.
+	 * @param value A value to set
+	 */
+	QWorld *SetDebugGizmosEnabled(bool value){
+		enableDebugGizmos=value;
+		if(value==false)
+			gizmos.Clear();
+		return this;
+	}
+
+	/** Sets whether the particle grid is used for the circle collisions of the soft bodies. If it's enabled, the world sorts the particles into a uniform hash grid once per iteration. The self collisions and the collisions between the circle meshes only test the particles in the neighbor cells, instead of the horizontal sweep and prune. It's useful for the scenes with large or tall soft bodies, and it's disabled by default.
+	 * @param value A value to set
+	 */
+	QWorld *SetParticleGridEnabled(bool value){
+		enableParticleGrid=value;
+		return this;
+	}
+
+	/** Sets whether the springs and the angle constraints of the soft bodies are solved with the batched constraint solver. If it's enabled, the springs and the angle constraints of every mesh are packed into flat arrays once per step and all constraints of a mesh are solved together with the averaged corrections (Jacobi), instead of one by one. The angle constraints are solved without trigonometric functions. The meshes are solved on the worker threads when there are enough constraints. It's useful for the soft bodies with dense grids, and it's disabled by default.
+	 * \note The batched constraints converge slower than the constraints solved one by one, the soft bodies may need more rigidity or iterations. The Update() methods of the custom spring and angle constraint classes aren't called, and it isn't used with the XPBD constraint solver.
+	 * @param value A value to set
+	 */
+	QWorld *SetBatchedConstraintsEnabled(bool value){
+		enableBatchedConstraints=value;
+		return this;
+	}
+	/** Sets whether the springs of the soft bodies are solved with the batched constraint solver. It's the same with SetBatchedConstraintsEnabled(), the angle constraints are batched together with the springs.
+	 * @param value A value to set
+	 */
+	QWorld *SetBatchedSpringsEnabled(bool value){
+		return SetBatchedConstraintsEnabled(value);
+	}
+
+	/** Sets whether the awake dynamic rigid bodies are integrated together. If it's enabled, the positions, the rotations and the forces of the rigid bodies are gathered into flat arrays once per step and the Verlet integration runs over all of them in tight loops, then the meshes of every body are transformed. It's useful for the worlds with many rigid bodies, and it's disabled by default.
+	 * \note The Update() methods of the custom classes inherited from QRigidBody aren't called for the batched bodies, the OnPreStep() event can be used instead.
+	 * @param value A value to set
+	 */
+	QWorld *SetBatchedRigidBodyIntegrationEnabled(bool value){
+		enableBatchedRigidBodyIntegration=value;
+		return this;
+	}
+
+	/** Sets whether the iteration count is adapted per island. If it's enabled, the world measures the maximum penetration of the contacts and the maximum spring error of every island after each iteration. The islands below the tolerance aren't solved in the next iterations, so quiet islands run a single pass while the hard ones get more. The minimum and maximum iteration counts can be set per body. It's disabled by default.
+	 * \note The islands connected with joints or world springs aren't measured, they're solved with their maximum iteration count.
+	 * @param value A value to set
+	 */
+	QWorld *SetAdaptiveIterationsEnabled(bool value){
+		enableAdaptiveIterations=value;
+		return this;
+	}
+	/** Sets the tolerance of the adaptive iterations. An island is converged when its maximum penetration and spring error are lower than this value. The default value is 0.05.
+	 * @param value A value to set
+	 */
+	QWorld *SetAdaptiveIterationsTolerance(float value){
+		adaptiveIterationsTolerance=value;
+		return this;
+	}
+
+	/** Sets the contact solver of the world. The positional solver is the default. The sequential impulse solver solves the contacts between rigid bodies with accumulated impulses and warm starting, so the stacks and the piles of rigid bodies settle with less jitter.
+	 * @param value A value to set
+	 */
+	QWorld *SetContactSolver(ContactSolvers value){
+		contactSolver=value;
+		contactImpulses.clear();
+		previousContactImpulses.clear();
+		return this;
+	}
+
+	/** Sets the constraint solver of the world. The PBD solver is the default and uses the rigidity values of the springs and the angle constraints. The XPBD solver uses their compliance values instead, so the soft bodies keep the same stiffness with fewer iterations or a different time scale.
+	 * @param value A value to set
+	 */
+	QWorld *SetConstraintSolver(ConstraintSolvers value){
+		constraintSolver=value;
+		return this;
+	}
+
 	/**Custom solutions inheriting from the QBroadphase class can be defined for the broad phase.
 	 * This allows external broad phase solutions to be plugged in or removed.
 	 * @param externalBroadphase A QBroadphase-typed class representing the external broad phase solution.
@@ -270,6 +479,14 @@ public:
 	 */
 	static vector<QCollision::Contact*> GetCollisions(QBody *bodyA, QBody *bodyB);
 
+	/**
+	 * Performs the collision of the body and appends the result contacts to the given contact list.
+	 * @param bodyA A body in the world.
+	 * @param bodyB Another body in the world.
+	 * @param contacts A contact list to append the contacts.
+	 */
+	static void GetCollisions(QBody *bodyA, QBody *bodyB,vector<QCollision::Contact*> &contacts);
+
 
 	/**Adds a body to the world
 	 * @param body A body to be added
@@ -331,7 +548,7 @@ public:
 	 */
 	bool CollideWithWorld(QBody *body);
 
-	/** Applies a collision test between a body and other bodies in the world, returning a list of manifolds if collisions are detected.
+	/** Applies a collision test between a body and other bodies in the world, returning a list of manifolds if collisions are detected. The contacts of the manifolds are valid until the next physics step.
 	 * @param body A body from the world.
 	 */
 	vector<QManifold> TestCollisionWithWorld(QBody *body);
@@ -454,9 +671,9 @@ public:
 	}
 
 	//Gizmos Operations
-	/**Returns the collection of gizmos in the world. 
+	/**Returns the gizmo buffer of the world. Gizmos are collected only if the debug gizmos option is enabled.
 	 */
-	vector<QGizmo*> *GetGizmos(){
+	QGizmoBuffer *GetGizmos(){
 		return &gizmos;
 	};
 
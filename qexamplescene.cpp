@@ -34,6 +34,8 @@
 QExampleScene::QExampleScene(QVector sceneSize)
 {
 	world=new QWorld();
+	//The example scenes render the collision gizmos
+	world->SetDebugGizmosEnabled(true);
 	//Trying QSpatialHashing broadphase extension
 	/* QSpatialHashing *broadPhase=new QSpatialHashing(world->bodies,128.0f);
 	world->SetBroadphase(broadPhase); */
@@ -249,40 +249,39 @@ void QPhysicsRenderer::RenderRaycasts(QWorld *world, sf::RenderWindow *window)
 
 void QPhysicsRenderer::RenderPhysicsGizmos(QWorld *world, sf::RenderWindow *window)
 {
-	for(int i=0;i<world->GetGizmos()->size();i++){
+	QGizmoBuffer *gizmos=world->GetGizmos();
+	for(size_t i=0;i<gizmos->GetCount();i++){
 
-		QGizmo *gizmo=world->GetGizmos()->at(i);
+		QGizmo &gizmo=gizmos->GetAt(i);
 		auto col=COLOR_CONTACT;
-		if(gizmo->GetGizmoType()==QGizmo::Circle){
-			QGizmoCircle *gizmoCircle=static_cast<QGizmoCircle*>(gizmo);
-			float r=gizmoCircle->radius;
+		if(gizmo.GetGizmoType()==QGizmo::Circle){
+			float r=gizmo.radius;
 			sf::CircleShape renderShape(r);
 			renderShape.setFillColor(col );
-			renderShape.setPosition(sf::Vector2f(gizmoCircle->position.x-r,gizmoCircle->position.y-r) );
+			renderShape.setPosition(sf::Vector2f(gizmo.pointA.x-r,gizmo.pointA.y-r) );
 			window->draw(renderShape);
 
-		}else if(gizmo->GetGizmoType()==QGizmo::Line){
-			QGizmoLine *gizmoLine=static_cast<QGizmoLine*>(gizmo);
+		}else if(gizmo.GetGizmoType()==QGizmo::Line){
 			sf::Vertex line[]{
-				sf::Vertex(sf::Vector2f(gizmoLine->pointA.x,gizmoLine->pointA.y) ),
-				sf::Vertex(sf::Vector2f(gizmoLine->pointB.x,gizmoLine->pointB.y) )
+				sf::Vertex(sf::Vector2f(gizmo.pointA.x,gizmo.pointA.y) ),
+				sf::Vertex(sf::Vector2f(gizmo.pointB.x,gizmo.pointB.y) )
 			};
 			line[0].color=col;
 			line[1].color=col;
 			window->draw(line,2,sf::Lines);
 
-			if(gizmoLine->isArrow){
-				QVector lineVec=gizmoLine->pointB-gizmoLine->pointA;
+			if(gizmo.isArrow){
+				QVector lineVec=gizmo.pointB-gizmo.pointA;
 				QVector unit=lineVec.Normalized();
 				float arrowLen=lineVec.Length()*0.1f;
-				QVector arrowA=gizmoLine->pointB-(unit*arrowLen+unit.Perpendicular()*arrowLen);
-				QVector arrowB=gizmoLine->pointB-(unit*arrowLen-unit.Perpendicular()*arrowLen);
+				QVector arrowA=gizmo.pointB-(unit*arrowLen+unit.Perpendicular()*arrowLen);
+				QVector arrowB=gizmo.pointB-(unit*arrowLen-unit.Perpendicular()*arrowLen);
 				sf::Vertex lineA[]{
-					sf::Vertex(sf::Vector2f(gizmoLine->pointB.x,gizmoLine->pointB.y) ),
+					sf::Vertex(sf::Vector2f(gizmo.pointB.x,gizmo.pointB.y) ),
 					sf::Vertex(sf::Vector2f(arrowA.x,arrowA.y) )
 				};
 				sf::Vertex lineB[]{
-					sf::Vertex(sf::Vector2f(gizmoLine->pointB.x,gizmoLine->pointB.y) ),
+					sf::Vertex(sf::Vector2f(gizmo.pointB.x,gizmo.pointB.y) ),
 					sf::Vertex(sf::Vector2f(arrowB.x,arrowB.y) )
 				};
 				lineA->color=col;
@@ -290,13 +289,13 @@ void QPhysicsRenderer::RenderPhysicsGizmos(QWorld *world, sf::RenderWindow *wind
 				window->draw(lineA,2,sf::Lines);
 				window->draw(lineB,2,sf::Lines);
 			}
-		}else if (gizmo->GetGizmoType()==QGizmo::Rectangle ){
-			QGizmoRect *gizmoRect=static_cast<QGizmoRect*>(gizmo);
-			sf::RectangleShape rectShape(sf::Vector2f(gizmoRect->rect.GetSize().x,gizmoRect->rect.GetSize().y ) );
+		}else if (gizmo.GetGizmoType()==QGizmo::Rectangle ){
+			QVector size=gizmo.pointB-gizmo.pointA;
+			sf::RectangleShape rectShape(sf::Vector2f(size.x,size.y ) );
 			rectShape.setFillColor(sf::Color::Transparent);
 			rectShape.setOutlineColor(col);
 			rectShape.setOutlineThickness(1.0);
-			rectShape.setPosition(sf::Vector2f (gizmoRect->rect.GetMin().x,gizmoRect->rect.GetMin().y ) );
+			rectShape.setPosition(sf::Vector2f (gizmo.pointA.x,gizmo.pointA.y ) );
 			window->draw(rectShape);
 		}
 	}
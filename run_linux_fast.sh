@@ -13,7 +13,7 @@ rm -rf build
 mkdir build
 cd build
 gcc $build_flag -c ../QuarkPhysics/*.cpp ../QuarkPhysics/extensions/*.cpp  ../QuarkPhysics/json/*.hpp ../QuarkPhysics/polypartition/*.cpp ../examples/*.cpp ../resources/*.hpp  ../*.cpp
-g++ -o QuarkPhysics ./*.o -lsfml-graphics -lsfml-window -lsfml-system
+g++ -o QuarkPhysics ./*.o -lsfml-graphics -lsfml-window -lsfml-system -pthread
 rm *.o
 echo "Build Succesfully! Running execute file..."
 ./QuarkPhysics